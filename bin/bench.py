@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Simulator throughput benchmark.
+
+Generates synthetic traces with `cachesim gen-trace` (once, cached in
+bench_traces/) and runs every replacement policy x prefetcher x geometry
+combination over every trace pattern, reporting records/sec, ns/access and
+peak RSS of the simulator itself. The results are printed and written to
+bench_output.txt.
+
+Environment variables:
+    BENCH_RECORDS   number of records per generated trace (default 1000000)
+    BENCH_PATTERNS  comma-separated trace patterns (default: all)
+    BENCH_POLICIES  comma-separated replacement policies (default: all)
+"""
+
+import csv
+import io
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+CACHESIM = os.path.join(ROOT, "cachesim")
+TRACE_DIR = os.path.join(ROOT, "bench_traces")
+OUTPUT = os.path.join(ROOT, "bench_output.txt")
+
+PATTERNS = ["sequential", "stride", "random", "zipf", "pointer-chase", "mixed"]
+POLICIES = ["LRU", "RAND", "LRU_PREFER_CLEAN", "OPT"]
+PREFETCHERS = [("NULL", 0), ("ADJACENT", 0), ("SEQUENTIAL", 2), ("CUSTOM", 0)]
+# (cache size, cache lines, associativity)
+GEOMETRIES = [(1024, 128, 2), (32768, 512, 8), (1048576, 16384, 16)]
+
+
+def env_list(name, default):
+    value = os.environ.get(name)
+    return value.split(",") if value else default
+
+
+def generate_trace(pattern, records):
+    path = os.path.join(TRACE_DIR, f"{pattern}-{records}")
+    if not os.path.exists(path):
+        os.makedirs(TRACE_DIR, exist_ok=True)
+        with open(path + ".tmp", "w") as out:
+            subprocess.run([CACHESIM, "gen-trace", pattern, str(records)], stdout=out,
+                           check=True)
+        os.rename(path + ".tmp", path)
+    return path
+
+
+def run(policy, prefetcher, amount, geometry, trace):
+    size, lines, assoc = geometry
+    result = subprocess.run(
+        [CACHESIM, policy, str(size), str(lines), str(assoc), prefetcher, str(amount),
+         "--format=csv", f"--trace={trace}"],
+        capture_output=True, text=True, check=True)
+    return next(csv.DictReader(io.StringIO(result.stdout)))
+
+
+def main():
+    records = int(os.environ.get("BENCH_RECORDS", "1000000"))
+    patterns = env_list("BENCH_PATTERNS", PATTERNS)
+    policies = env_list("BENCH_POLICIES", POLICIES)
+
+    header = (f"{'pattern':<14} {'policy':<17} {'prefetcher':<12} {'geometry':<18} "
+              f"{'records/s':>12} {'ns/access':>10} {'rss KB':>8} {'hit ratio':>10}")
+    lines = [header, "-" * len(header)]
+    print(header)
+    print(lines[1])
+    total_seconds = 0.0
+    total_records = 0
+    for pattern in patterns:
+        trace = generate_trace(pattern, records)
+        for policy in policies:
+            for prefetcher, amount in PREFETCHERS:
+                for geometry in GEOMETRIES:
+                    row = run(policy, prefetcher, amount, geometry, trace)
+                    total_seconds += float(row["wall_seconds"])
+                    total_records += int(row["trace_records"])
+                    line = (f"{pattern:<14} {policy:<17} {prefetcher:<12} "
+                            f"{'-'.join(map(str, geometry)):<18} "
+                            f"{float(row['records_per_second']):>12.0f} "
+                            f"{float(row['ns_per_access']):>10.1f} "
+                            f"{row['peak_rss_kb']:>8} {float(row['hit_ratio']):>10.6f}")
+                    lines.append(line)
+                    print(line, flush=True)
+
+    summary = (f"\nTotal: {total_records} records in {total_seconds:.2f}s "
+               f"({total_records / total_seconds:.0f} records/s overall)")
+    lines.append(summary)
+    print(summary)
+    with open(OUTPUT, "w") as out:
+        out.write("\n".join(lines) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
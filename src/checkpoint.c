@@ -0,0 +1,176 @@
+//
+// This file contains the implementations for the functions defined in
+// checkpoint.h.
+//
+// Layout of a checkpoint file:
+//
+//      header (struct checkpoint_header)
+//      statistics (struct cache_system_stats)
+//      cache lines (num_sets * associativity struct cache_line)
+//      accessed-lines set (uint64_t count, then count uint32_t line IDs)
+//      replacement policy state (written by replacement_policy->save)
+//      prefetcher state (written by prefetcher->save)
+//
+
+#include <string.h>
+
+#include "checkpoint.h"
+#include "line_map.h"
+
+struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t line_size, num_sets, associativity;
+    char replacement_policy[CHECKPOINT_NAME_SIZE];
+    char prefetch_strategy[CHECKPOINT_NAME_SIZE];
+    uint32_t prefetch_amount;
+    uint32_t write_policy, write_allocate;
+    uint32_t sectors;
+    uint32_t index_function;
+    uint32_t page_bits, prefetch_pages;
+    uint64_t position;
+    uint64_t trace_hash;
+};
+
+static void checkpoint_header_init(struct checkpoint_header *header,
+                                   struct cache_system *cache_system,
+                                   struct checkpoint_config *config, uint64_t position,
+                                   uint64_t trace_hash)
+{
+    memset(header, 0, sizeof(struct checkpoint_header));
+    memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic));
+    header->version = CHECKPOINT_VERSION;
+    header->line_size = cache_system->line_size;
+    header->num_sets = cache_system->num_sets;
+    header->associativity = cache_system->associativity;
+    strncpy(header->replacement_policy, config->replacement_policy, CHECKPOINT_NAME_SIZE - 1);
+    strncpy(header->prefetch_strategy, config->prefetch_strategy, CHECKPOINT_NAME_SIZE - 1);
+    header->prefetch_amount = config->prefetch_amount;
+    header->write_policy = cache_system->write_policy;
+    header->write_allocate = cache_system->write_allocate;
+    header->sectors = cache_system->sectors;
+    header->index_function = cache_system->index_function;
+    header->page_bits = cache_system->page_bits;
+    header->prefetch_pages = cache_system->prefetch_pages;
+    header->position = position;
+    header->trace_hash = trace_hash;
+}
+
+static int checkpoint_write(struct cache_system *cache_system, struct checkpoint_header *header,
+                            FILE *file)
+{
+    if (fwrite(header, sizeof(struct checkpoint_header), 1, file) != 1) return 1;
+    if (fwrite(&cache_system->stats, sizeof(struct cache_system_stats), 1, file) != 1) return 1;
+
+    size_t num_lines = cache_system->num_sets * cache_system->associativity;
+    if (fwrite(cache_system->cache_lines, sizeof(struct cache_line), num_lines, file) != num_lines)
+        return 1;
+
+    // Write the accessed-lines set as a count followed by the line IDs.
+    struct line_map *accessed = cache_system->accessed_lines;
+    uint64_t count = accessed->size;
+    if (fwrite(&count, sizeof(count), 1, file) != 1) return 1;
+    for (size_t i = 0; i < accessed->capacity; i++) {
+        if (!accessed->entries[i].used) continue;
+        if (fwrite(&accessed->entries[i].key, sizeof(uint32_t), 1, file) != 1) return 1;
+    }
+
+    if (cache_system->replacement_policy->save(cache_system->replacement_policy, file)) return 1;
+    if (cache_system->prefetcher->save != NULL &&
+        cache_system->prefetcher->save(cache_system->prefetcher, file))
+        return 1;
+    return 0;
+}
+
+int checkpoint_save(const char *path, struct cache_system *cache_system,
+                    struct checkpoint_config *config, uint64_t position, uint64_t trace_hash)
+{
+    if (cache_system->replacement_policy->save == NULL) {
+        fprintf(stderr, "Replacement policy %s does not support checkpoints\n",
+                config->replacement_policy);
+        return 1;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    struct checkpoint_header header;
+    checkpoint_header_init(&header, cache_system, config, position, trace_hash);
+    int result = checkpoint_write(cache_system, &header, file);
+    if (fclose(file) != 0) result = 1;
+    if (result != 0) {
+        fprintf(stderr, "Failed to write checkpoint %s\n", path);
+    }
+    return result;
+}
+
+static int checkpoint_read(struct cache_system *cache_system, FILE *file)
+{
+    if (fread(&cache_system->stats, sizeof(struct cache_system_stats), 1, file) != 1) return 1;
+
+    size_t num_lines = cache_system->num_sets * cache_system->associativity;
+    if (fread(cache_system->cache_lines, sizeof(struct cache_line), num_lines, file) != num_lines)
+        return 1;
+
+    uint64_t count;
+    if (fread(&count, sizeof(count), 1, file) != 1) return 1;
+    for (uint64_t i = 0; i < count; i++) {
+        uint32_t line_id;
+        if (fread(&line_id, sizeof(uint32_t), 1, file) != 1) return 1;
+        cache_system_line_id_add(cache_system, line_id);
+    }
+
+    if (cache_system->replacement_policy->load(cache_system->replacement_policy, file)) return 1;
+    if (cache_system->prefetcher->load != NULL &&
+        cache_system->prefetcher->load(cache_system->prefetcher, file))
+        return 1;
+    return 0;
+}
+
+int checkpoint_load(const char *path, struct cache_system *cache_system,
+                    struct checkpoint_config *config, uint64_t *position,
+                    uint64_t *trace_hash)
+{
+    if (cache_system->replacement_policy->load == NULL) {
+        fprintf(stderr, "Replacement policy %s does not support checkpoints\n",
+                config->replacement_policy);
+        return 1;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    // Make sure the checkpoint was taken with the same configuration.
+    struct checkpoint_header header, expected;
+    checkpoint_header_init(&expected, cache_system, config, 0, 0);
+    if (fread(&header, sizeof(struct checkpoint_header), 1, file) != 1 ||
+        memcmp(header.magic, expected.magic, sizeof(header.magic)) ||
+        header.version != expected.version) {
+        fprintf(stderr, "%s is not a checkpoint written by this simulator\n", path);
+        fclose(file);
+        return 1;
+    }
+    expected.position = header.position;
+    expected.trace_hash = header.trace_hash;
+    if (memcmp(&header, &expected, sizeof(struct checkpoint_header))) {
+        fprintf(stderr, "Checkpoint %s was taken with a different configuration\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    int result = checkpoint_read(cache_system, file);
+    fclose(file);
+    if (result != 0) {
+        fprintf(stderr, "Checkpoint %s is truncated or corrupt\n", path);
+        return 1;
+    }
+    *position = header.position;
+    *trace_hash = header.trace_hash;
+    return 0;
+}
@@ -0,0 +1,46 @@
+//
+// This file defines the function signatures for saving the full state of a
+// cache system (cache lines, statistics, the accessed-lines set, and the state
+// of the replacement policy and prefetcher) to a binary checkpoint file and for
+// restoring it.
+//
+// A checkpoint is tied to the configuration it was taken with, to the trace it
+// was taken on, and to the build of the simulator that wrote it. Loading checks
+// the configuration and refuses checkpoints that do not match; the caller
+// checks the trace against the hash of the records before the checkpoint.
+//
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+
+#include "memory_system.h"
+
+#define CHECKPOINT_MAGIC "CSIMCKPT"
+#define CHECKPOINT_VERSION 10
+#define CHECKPOINT_NAME_SIZE 32
+
+// The parts of the configuration that are not stored in the cache system.
+struct checkpoint_config {
+    const char *replacement_policy;
+    const char *prefetch_strategy;
+    uint32_t prefetch_amount;
+};
+
+// Write the state of the cache system to `path`. `position` is the number of
+// trace records that have been simulated so far, and `trace_hash` is their hash
+// (see trace_hash_record).
+// Returns: 0 on success, non-zero on failure (an error is printed).
+int checkpoint_save(const char *path, struct cache_system *cache_system,
+                    struct checkpoint_config *config, uint64_t position, uint64_t trace_hash);
+
+// Restore the state of the cache system from `path`, storing the number of
+// trace records that were simulated before the checkpoint in `position` and
+// their hash in `trace_hash`.
+// Returns: 0 on success, non-zero on failure (an error is printed).
+int checkpoint_load(const char *path, struct cache_system *cache_system,
+                    struct checkpoint_config *config, uint64_t *position,
+                    uint64_t *trace_hash);
+
+#endif
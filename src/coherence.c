@@ -0,0 +1,253 @@
+//
+// This file contains the implementations for the functions defined in
+// coherence.h.
+//
+// MESI transitions handled here (the private cache handles the rest):
+//
+//  * Read fill:   other copies E/M -> S (M is written back); the new copy is
+//                 S if any other core holds the line, E otherwise.
+//  * Write fill:  other copies -> I (M is written back); the new copy is M.
+//  * Write hit S: other copies -> I; the copy becomes M (an upgrade).
+//  * Write hit E: the copy silently becomes M.
+//
+
+#include <string.h>
+
+#include "coherence.h"
+#include "line_map.h"
+
+static uint64_t core_bit(uint32_t core)
+{
+    return 1ull << core;
+}
+
+struct multicore_system *multicore_system_new(struct cache_system **cores, uint32_t num_cores,
+                                              struct cache_system *llc)
+{
+    struct multicore_system *system = calloc(1, sizeof(struct multicore_system));
+    system->num_cores = num_cores;
+    system->cores = cores;
+    system->llc = llc;
+    system->sharers = line_map_new(4096);
+    system->invalidated = line_map_new(1024);
+    for (uint32_t i = 0; i < num_cores; i++) {
+        cores[i]->coherence = system;
+        cores[i]->core_id = i;
+    }
+    return system;
+}
+
+void multicore_system_cleanup(struct multicore_system *system)
+{
+    line_map_cleanup(system->sharers);
+    free(system->sharers);
+    line_map_cleanup(system->invalidated);
+    free(system->invalidated);
+}
+
+// Write a dirty line back from a private cache. Without an LLC, the line goes
+// straight to memory. The LLC is non-inclusive, so the line is only updated if
+// it is present.
+static void coherence_writeback(struct multicore_system *system, uint32_t line_id)
+{
+    if (system->llc == NULL) return;
+    struct cache_line *cl = cache_system_lookup_line(system->llc, line_id);
+    if (cl != NULL) {
+        cl->status = MODIFIED;
+        system->stats.llc_writebacks++;
+    }
+}
+
+// Invalidate the copies of the line held by every core in `cores`.
+static void coherence_invalidate(struct multicore_system *system, uint64_t cores,
+                                 uint32_t line_id)
+{
+    uint64_t *invalidated = line_map_upsert(system->invalidated, line_id, 0);
+    for (uint32_t core = 0; cores != 0; core++, cores >>= 1) {
+        if (!(cores & 1)) continue;
+        struct cache_line *cl = cache_system_lookup_line(system->cores[core], line_id);
+        if (cl == NULL) continue;
+        if (cl->status == MODIFIED) {
+            system->stats.coherence_writebacks++;
+            coherence_writeback(system, line_id);
+        }
+        cl->status = INVALID;
+        *invalidated |= core_bit(core);
+        system->stats.invalidations++;
+    }
+}
+
+// Downgrade the copies of the line held by every core in `cores` to SHARED.
+static void coherence_downgrade(struct multicore_system *system, uint64_t cores,
+                                uint32_t line_id)
+{
+    for (uint32_t core = 0; cores != 0; core++, cores >>= 1) {
+        if (!(cores & 1)) continue;
+        struct cache_line *cl = cache_system_lookup_line(system->cores[core], line_id);
+        if (cl == NULL || cl->status == SHARED) continue;
+        if (cl->status == MODIFIED) {
+            system->stats.coherence_writebacks++;
+            coherence_writeback(system, line_id);
+        }
+        cl->status = SHARED;
+        system->stats.downgrades++;
+    }
+}
+
+bool coherence_take_invalidated(struct multicore_system *system, uint32_t core,
+                                uint32_t line_id)
+{
+    uint64_t *invalidated = line_map_get(system->invalidated, line_id);
+    if (invalidated == NULL || !(*invalidated & core_bit(core))) return false;
+    *invalidated &= ~core_bit(core);
+    return true;
+}
+
+enum cache_status coherence_fill(struct multicore_system *system, uint32_t core,
+                                 uint32_t line_id, char rw)
+{
+    uint64_t *invalidated = line_map_get(system->invalidated, line_id);
+    if (invalidated != NULL) *invalidated &= ~core_bit(core);
+
+    uint64_t others = *line_map_upsert(system->sharers, line_id, 0) & ~core_bit(core);
+    enum cache_status status;
+    if (rw == 'W') {
+        coherence_invalidate(system, others, line_id);
+        others = 0;
+        status = MODIFIED;
+    } else if (others != 0) {
+        coherence_downgrade(system, others, line_id);
+        status = SHARED;
+    } else {
+        status = EXCLUSIVE;
+    }
+
+    // The invalidations above may have grown the other map, but not this one.
+    *line_map_get(system->sharers, line_id) = others | core_bit(core);
+    return status;
+}
+
+void coherence_upgrade(struct multicore_system *system, uint32_t core, uint32_t line_id)
+{
+    uint64_t *sharers = line_map_upsert(system->sharers, line_id, 0);
+    uint64_t others = *sharers & ~core_bit(core);
+    *sharers = core_bit(core);
+    coherence_invalidate(system, others, line_id);
+    system->stats.upgrades++;
+}
+
+void coherence_evict(struct multicore_system *system, uint32_t core, uint32_t line_id,
+                     enum cache_status status)
+{
+    uint64_t *sharers = line_map_get(system->sharers, line_id);
+    if (sharers != NULL) *sharers &= ~core_bit(core);
+    if (status == MODIFIED) coherence_writeback(system, line_id);
+}
+
+int multicore_mem_access(struct multicore_system *system, uint32_t core, uint32_t address,
+                         char rw)
+{
+    if (core >= system->num_cores) {
+        fprintf(stderr, "Access from core %u, but only %u cores are simulated\n", core,
+                system->num_cores);
+        return 1;
+    }
+
+    struct cache_system *cs = system->cores[core];
+    uint64_t misses = cs->stats.misses;
+    if (cache_system_mem_access(cs, address, rw, false) != 0) return 1;
+
+    // Private cache misses are filled from the LLC. Writes allocate in the
+    // private cache, so the LLC sees them as reads for ownership.
+    if (system->llc != NULL && cs->stats.misses != misses) {
+        return cache_system_mem_access(system->llc, address, 'R', false);
+    }
+    return 0;
+}
+
+void multicore_reset_stats(struct multicore_system *system)
+{
+    for (uint32_t i = 0; i < system->num_cores; i++) {
+        memset(&system->cores[i]->stats, 0, sizeof(struct cache_system_stats));
+    }
+    if (system->llc != NULL) {
+        memset(&system->llc->stats, 0, sizeof(struct cache_system_stats));
+    }
+    memset(&system->stats, 0, sizeof(struct coherence_stats));
+}
+
+void multicore_total_stats(struct multicore_system *system, struct cache_system_stats *total)
+{
+    memset(total, 0, sizeof(struct cache_system_stats));
+    for (uint32_t i = 0; i < system->num_cores; i++) {
+        for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+            const struct cache_system_stat_field *field = &cache_system_stat_fields[f];
+            cache_system_stat_set(total, field,
+                                  cache_system_stat(total, field) +
+                                      cache_system_stat(&system->cores[i]->stats, field));
+        }
+    }
+}
+
+static double hit_ratio(struct cache_system_stats *stats)
+{
+    return stats->accesses == 0 ? 0.0 : (double)stats->hits / stats->accesses;
+}
+
+void multicore_print_text(FILE *out, struct multicore_system *system)
+{
+    struct coherence_stats *stats = &system->stats;
+    fprintf(out, "OUTPUT INVALIDATIONS %u\n", stats->invalidations);
+    fprintf(out, "OUTPUT UPGRADES %u\n", stats->upgrades);
+    fprintf(out, "OUTPUT DOWNGRADES %u\n", stats->downgrades);
+    fprintf(out, "OUTPUT COHERENCE WRITEBACKS %u\n", stats->coherence_writebacks);
+    for (uint32_t i = 0; i < system->num_cores; i++) {
+        struct cache_system_stats *core = &system->cores[i]->stats;
+        fprintf(out, "OUTPUT CORE %u ACCESSES %lu HITS %lu MISSES %lu COHERENCE MISSES %lu "
+                     "HIT RATIO %.8f\n",
+                i, (unsigned long)core->accesses, (unsigned long)core->hits,
+                (unsigned long)core->misses, (unsigned long)core->coherence_misses,
+                hit_ratio(core));
+    }
+    if (system->llc != NULL) {
+        struct cache_system_stats *llc = &system->llc->stats;
+        fprintf(out, "OUTPUT LLC ACCESSES %lu\n", (unsigned long)llc->accesses);
+        fprintf(out, "OUTPUT LLC HITS %lu\n", (unsigned long)llc->hits);
+        fprintf(out, "OUTPUT LLC MISSES %lu\n", (unsigned long)llc->misses);
+        fprintf(out, "OUTPUT LLC WRITEBACKS %u\n", stats->llc_writebacks);
+        fprintf(out, "OUTPUT LLC DIRTY EVICTIONS %lu\n", (unsigned long)llc->dirty_evictions);
+        fprintf(out, "OUTPUT LLC HIT RATIO %.8f\n", hit_ratio(llc));
+    }
+}
+
+static void print_stats_json(FILE *out, struct cache_system_stats *stats)
+{
+    fprintf(out, "{");
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        fprintf(out, "%s\"%s\": %lu", f ? ", " : "", cache_system_stat_fields[f].name,
+                (unsigned long)cache_system_stat(stats, &cache_system_stat_fields[f]));
+    }
+    fprintf(out, ", \"hit_ratio\": %.8f}", hit_ratio(stats));
+}
+
+void multicore_print_json(FILE *out, struct multicore_system *system)
+{
+    struct coherence_stats *stats = &system->stats;
+    fprintf(out,
+            "\"multicore\": {\"cores\": %u, \"coherence\": {\"invalidations\": %u, "
+            "\"upgrades\": %u, \"downgrades\": %u, \"coherence_writebacks\": %u, "
+            "\"llc_writebacks\": %u}, \"per_core\": [",
+            system->num_cores, stats->invalidations, stats->upgrades, stats->downgrades,
+            stats->coherence_writebacks, stats->llc_writebacks);
+    for (uint32_t i = 0; i < system->num_cores; i++) {
+        if (i) fprintf(out, ", ");
+        print_stats_json(out, &system->cores[i]->stats);
+    }
+    fprintf(out, "], \"llc\": ");
+    if (system->llc != NULL) {
+        print_stats_json(out, &system->llc->stats);
+    } else {
+        fprintf(out, "null");
+    }
+    fprintf(out, "}");
+}
@@ -0,0 +1,91 @@
+//
+// This file defines the structs and function signatures for multi-core
+// simulation. Every core has a private cache system, and the cores optionally
+// share a last-level cache (LLC). The private caches are kept coherent with
+// the MESI protocol using a directory that tracks, for every line, the set of
+// cores holding it. The directory means writes only probe the cores that
+// actually hold the line instead of broadcasting to every core.
+//
+// The private cache systems call back into the directory (through their
+// `coherence` pointer) when they fill, upgrade, or evict a line; see
+// cache_system_mem_access.
+//
+
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct cache_system;
+struct line_map;
+#include "memory_system.h"
+
+#define COHERENCE_MAX_CORES 64
+
+// Statistics about the coherence traffic between the cores.
+struct coherence_stats {
+    uint32_t invalidations;        // Copies invalidated in other cores by writes
+    uint32_t upgrades;             // Write hits on SHARED lines
+    uint32_t downgrades;           // EXCLUSIVE/MODIFIED copies downgraded to SHARED by reads
+    uint32_t coherence_writebacks; // MODIFIED copies written back due to a downgrade/invalidation
+    uint32_t llc_writebacks;       // Dirty lines written back from a private cache to the LLC
+};
+
+struct multicore_system {
+    uint32_t num_cores;
+    struct cache_system **cores; // The private cache system of each core
+    struct cache_system *llc;    // The shared last-level cache (NULL if none)
+
+    // The directory: for every line, a bitmask of the cores holding it and a
+    // bitmask of the cores whose copy was invalidated by another core.
+    struct line_map *sharers;
+    struct line_map *invalidated;
+
+    struct coherence_stats stats;
+};
+
+// Create a multi-core system from already-constructed private caches (and an
+// optional LLC with the same line size). The private caches are connected to
+// the directory.
+struct multicore_system *multicore_system_new(struct cache_system **cores, uint32_t num_cores,
+                                              struct cache_system *llc);
+void multicore_system_cleanup(struct multicore_system *system);
+
+// Perform a demand access from the given core. Private cache misses are
+// forwarded to the LLC.
+int multicore_mem_access(struct multicore_system *system, uint32_t core, uint32_t address,
+                         char rw);
+
+// Reset the statistics of every cache and of the coherence traffic.
+void multicore_reset_stats(struct multicore_system *system);
+
+// Sum the statistics of all of the private caches.
+void multicore_total_stats(struct multicore_system *system, struct cache_system_stats *total);
+
+// Print the per-core, LLC, and coherence statistics as `OUTPUT ...` lines or as
+// a JSON fragment (`"multicore": {...}`, without a leading comma).
+void multicore_print_text(FILE *out, struct multicore_system *system);
+void multicore_print_json(FILE *out, struct multicore_system *system);
+
+// Callbacks from cache_system_mem_access.
+//
+// Called on a demand miss. Returns whether the core's copy of the line was
+// invalidated by another core (i.e. this is a coherence miss).
+bool coherence_take_invalidated(struct multicore_system *system, uint32_t core,
+                                uint32_t line_id);
+
+// Called when a line is filled into a core. Returns the MESI state the line
+// must be installed in.
+enum cache_status coherence_fill(struct multicore_system *system, uint32_t core,
+                                 uint32_t line_id, char rw);
+
+// Called on a write hit to a SHARED line.
+void coherence_upgrade(struct multicore_system *system, uint32_t core, uint32_t line_id);
+
+// Called when a line with the given status is evicted from a core.
+void coherence_evict(struct multicore_system *system, uint32_t core, uint32_t line_id,
+                     enum cache_status status);
+
+#endif
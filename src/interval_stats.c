@@ -0,0 +1,126 @@
+//
+// This file contains the implementations for the functions defined in
+// interval_stats.h.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "interval_stats.h"
+
+#define INTERVAL_STATS_INITIAL_CAPACITY 1024
+
+struct interval_stats *interval_stats_new(uint32_t interval, size_t expected_intervals)
+{
+    struct interval_stats *intervals = calloc(1, sizeof(struct interval_stats));
+    intervals->interval = interval;
+    intervals->next_sample = interval;
+    intervals->capacity =
+        expected_intervals > 0 ? expected_intervals : INTERVAL_STATS_INITIAL_CAPACITY;
+    intervals->columns = calloc(cache_system_num_stat_fields, sizeof(uint64_t *));
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        intervals->columns[f] = malloc(intervals->capacity * sizeof(uint64_t));
+    }
+    return intervals;
+}
+
+void interval_stats_cleanup(struct interval_stats *intervals)
+{
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        free(intervals->columns[f]);
+    }
+    free(intervals->columns);
+}
+
+void interval_stats_sample(struct interval_stats *intervals, struct cache_system_stats *stats)
+{
+    // Growing only happens here, once per interval, so it does not add to the
+    // per-access cost.
+    if (intervals->count == intervals->capacity) {
+        intervals->capacity *= 2;
+        for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+            intervals->columns[f] =
+                realloc(intervals->columns[f], intervals->capacity * sizeof(uint64_t));
+        }
+    }
+
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        const struct cache_system_stat_field *field = &cache_system_stat_fields[f];
+        intervals->columns[f][intervals->count] =
+            cache_system_stat(stats, field) - cache_system_stat(&intervals->last, field);
+    }
+    intervals->count++;
+    intervals->last = *stats;
+    intervals->next_sample = stats->accesses + intervals->interval;
+}
+
+void interval_stats_restart(struct interval_stats *intervals, struct cache_system_stats *stats)
+{
+    intervals->count = 0;
+    intervals->last = *stats;
+    intervals->next_sample = stats->accesses + intervals->interval;
+}
+
+void interval_stats_finish(struct interval_stats *intervals, struct cache_system_stats *stats)
+{
+    if (stats->accesses != intervals->last.accesses) {
+        interval_stats_sample(intervals, stats);
+    }
+}
+
+// Index of the given statistic within the columns.
+static size_t interval_stats_column(const char *name)
+{
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        if (!strcmp(cache_system_stat_fields[f].name, name)) return f;
+    }
+    return 0;
+}
+
+static double interval_hit_ratio(struct interval_stats *intervals, size_t i, size_t accesses_col,
+                                 size_t hits_col)
+{
+    uint64_t accesses = intervals->columns[accesses_col][i];
+    return accesses == 0 ? 0.0 : (double)intervals->columns[hits_col][i] / accesses;
+}
+
+void interval_stats_print_csv(FILE *out, struct interval_stats *intervals)
+{
+    size_t accesses_col = interval_stats_column("accesses");
+    size_t hits_col = interval_stats_column("hits");
+
+    fprintf(out, "interval");
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        fprintf(out, ",%s", cache_system_stat_fields[f].name);
+    }
+    fprintf(out, ",hit_ratio\n");
+
+    for (size_t i = 0; i < intervals->count; i++) {
+        fprintf(out, "%zu", i);
+        for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+            fprintf(out, ",%lu", (unsigned long)intervals->columns[f][i]);
+        }
+        fprintf(out, ",%.8f\n", interval_hit_ratio(intervals, i, accesses_col, hits_col));
+    }
+}
+
+void interval_stats_print_json(FILE *out, struct interval_stats *intervals)
+{
+    size_t accesses_col = interval_stats_column("accesses");
+    size_t hits_col = interval_stats_column("hits");
+
+    fprintf(out, "{\"interval\": %u, \"count\": %zu", intervals->interval, intervals->count);
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        fprintf(out, ", \"%s\": [", cache_system_stat_fields[f].name);
+        for (size_t i = 0; i < intervals->count; i++) {
+            fprintf(out, "%s%lu", i ? ", " : "", (unsigned long)intervals->columns[f][i]);
+        }
+        fprintf(out, "]");
+    }
+    fprintf(out, ", \"hit_ratio\": [");
+    for (size_t i = 0; i < intervals->count; i++) {
+        fprintf(out, "%s%.8f", i ? ", " : "",
+                interval_hit_ratio(intervals, i, accesses_col, hits_col));
+    }
+    fprintf(out, "]}");
+}
@@ -0,0 +1,55 @@
+//
+// This file defines the struct and function signatures for interval (phase)
+// statistics: every N demand accesses, the cache system statistics are
+// snapshotted and the difference from the previous snapshot is appended to a
+// columnar time series.
+//
+// The only per-access cost is the comparison of stats.accesses against
+// next_sample, which the caller performs inline:
+//
+//      if (cache_system->stats.accesses == intervals->next_sample)
+//          interval_stats_sample(intervals, &cache_system->stats);
+//
+
+#ifndef INTERVAL_STATS_H
+#define INTERVAL_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "memory_system.h"
+
+struct interval_stats {
+    uint32_t interval;    // Number of demand accesses per interval
+    uint64_t next_sample; // Value of stats.accesses at which to take the next sample
+
+    // The statistics at the end of the previous interval.
+    struct cache_system_stats last;
+
+    // One column per statistic, each holding the per-interval deltas.
+    uint64_t **columns;
+    size_t count;
+    size_t capacity;
+};
+
+// Create a new time series sampled every `interval` demand accesses.
+// `expected_intervals` is used to preallocate the columns (pass 0 if unknown).
+struct interval_stats *interval_stats_new(uint32_t interval, size_t expected_intervals);
+void interval_stats_cleanup(struct interval_stats *intervals);
+
+// Record the interval that ends at the current statistics.
+void interval_stats_sample(struct interval_stats *intervals, struct cache_system_stats *stats);
+
+// Restart the time series from the given statistics (e.g. after they are reset).
+void interval_stats_restart(struct interval_stats *intervals, struct cache_system_stats *stats);
+
+// Record the final, partial interval (if there is one).
+void interval_stats_finish(struct interval_stats *intervals, struct cache_system_stats *stats);
+
+// Print the time series as CSV, one row per interval.
+void interval_stats_print_csv(FILE *out, struct interval_stats *intervals);
+
+// Print the time series as a JSON object with one array per statistic.
+void interval_stats_print_json(FILE *out, struct interval_stats *intervals);
+
+#endif
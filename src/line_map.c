@@ -0,0 +1,113 @@
+//
+// This file contains the implementations for the functions defined in
+// line_map.h.
+//
+// The map uses linear probing and is kept at most half full so that probe
+// sequences stay short.
+//
+
+#include "line_map.h"
+
+static size_t line_map_slot(uint32_t key, size_t capacity)
+{
+    // Fibonacci hashing spreads sequential line IDs across the table.
+    return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+struct line_map *line_map_new(size_t capacity_hint)
+{
+    struct line_map *map = malloc(sizeof(struct line_map));
+    map->capacity = 16;
+    while (map->capacity < capacity_hint * 2) {
+        map->capacity <<= 1;
+    }
+    map->size = 0;
+    map->entries = calloc(map->capacity, sizeof(struct line_map_entry));
+    return map;
+}
+
+void line_map_cleanup(struct line_map *map)
+{
+    free(map->entries);
+}
+
+static void line_map_grow(struct line_map *map)
+{
+    struct line_map_entry *old_entries = map->entries;
+    size_t old_capacity = map->capacity;
+
+    map->capacity <<= 1;
+    map->entries = calloc(map->capacity, sizeof(struct line_map_entry));
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (!old_entries[i].used) continue;
+        size_t slot = line_map_slot(old_entries[i].key, map->capacity);
+        while (map->entries[slot].used) {
+            slot = (slot + 1) & (map->capacity - 1);
+        }
+        map->entries[slot] = old_entries[i];
+    }
+    free(old_entries);
+}
+
+uint64_t *line_map_get(struct line_map *map, uint32_t key)
+{
+    size_t slot = line_map_slot(key, map->capacity);
+    while (map->entries[slot].used) {
+        if (map->entries[slot].key == key) {
+            return &map->entries[slot].value;
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+    return NULL;
+}
+
+uint64_t *line_map_upsert(struct line_map *map, uint32_t key, uint64_t initial)
+{
+    if ((map->size + 1) * 2 > map->capacity) {
+        line_map_grow(map);
+    }
+
+    size_t slot = line_map_slot(key, map->capacity);
+    while (map->entries[slot].used) {
+        if (map->entries[slot].key == key) {
+            return &map->entries[slot].value;
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+
+    map->entries[slot].used = true;
+    map->entries[slot].key = key;
+    map->entries[slot].value = initial;
+    map->size++;
+    return &map->entries[slot].value;
+}
+
+void line_map_put(struct line_map *map, uint32_t key, uint64_t value)
+{
+    *line_map_upsert(map, key, value) = value;
+}
+
+bool line_map_remove(struct line_map *map, uint32_t key)
+{
+    size_t mask = map->capacity - 1;
+    size_t slot = line_map_slot(key, map->capacity);
+    while (map->entries[slot].used && map->entries[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    if (!map->entries[slot].used) return false;
+
+    // Backward-shift deletion: move later entries of the probe run into the
+    // hole whenever their home slot does not lie between the hole and them,
+    // so that no tombstones are needed.
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; map->entries[next].used; next = (next + 1) & mask) {
+        size_t home = line_map_slot(map->entries[next].key, map->capacity);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->entries[hole] = map->entries[next];
+            hole = next;
+        }
+    }
+    map->entries[hole].used = false;
+    map->size--;
+    return true;
+}
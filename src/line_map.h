@@ -0,0 +1,47 @@
+//
+// This file defines a small open-addressing hash map from 32-bit line IDs to
+// 64-bit values. It is used anywhere the simulator needs a per-line lookup
+// (for example, the accessed-lines set of a cache system, the next-use index of
+// the OPT replacement policy, and the coherence directory).
+//
+
+#ifndef LINE_MAP_H
+#define LINE_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct line_map_entry {
+    uint32_t key;
+    bool used;
+    uint64_t value;
+};
+
+struct line_map {
+    struct line_map_entry *entries;
+    size_t capacity; // Always a power of two.
+    size_t size;
+};
+
+// Create a new map that can hold at least `capacity_hint` keys before growing.
+struct line_map *line_map_new(size_t capacity_hint);
+void line_map_cleanup(struct line_map *map);
+
+// Returns a pointer to the value stored for `key`, or NULL if the key is not
+// in the map. The pointer is invalidated by the next insertion.
+uint64_t *line_map_get(struct line_map *map, uint32_t key);
+
+// Returns a pointer to the value stored for `key`, inserting the key with
+// `initial` as its value if it is not yet in the map. The pointer is
+// invalidated by the next insertion.
+uint64_t *line_map_upsert(struct line_map *map, uint32_t key, uint64_t initial);
+
+// Store `value` for `key`, overwriting any previous value.
+void line_map_put(struct line_map *map, uint32_t key, uint64_t value);
+
+// Remove `key` from the map. Returns whether the key was in the map. Pointers
+// returned by the other functions are invalidated.
+bool line_map_remove(struct line_map *map, uint32_t key);
+
+#endif
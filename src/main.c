@@ -10,14 +10,150 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <time.h>
 
+#include "checkpoint.h"
+#include "coherence.h"
+#include "interval_stats.h"
 #include "memory_system.h"
+#include "options.h"
+#include "parallel_sim.h"
+#include "profile.h"
 #include "replacement_policies.h"
+#include "results.h"
+#include "serve.h"
+#include "simpoint.h"
+#include "stream_buffer.h"
+#include "trace.h"
+#include "trace_analyze.h"
+#include "trace_gen.h"
+#include "timing.h"
+#include "tlb.h"
+#include "victim_cache.h"
+#include "write_buffer.h"
+
+static double monotonic_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Check that the number of sets can be indexed with the index function, which
+// needs a power of two unless it is prime-modulo indexing.
+static bool sets_valid(uint32_t sets, enum cache_index_function index_function)
+{
+    if (sets == 0 || ((sets & (sets - 1)) && index_function != INDEX_PRIME)) {
+        fprintf(stderr, "The number of sets (%u) must be a power of two, except with "
+                        "--index=prime\n",
+                sets);
+        return false;
+    }
+    return true;
+}
+
+// Returns whether a TLB level with the given geometry can be built.
+static bool tlb_geometry_valid(uint32_t entries, uint32_t associativity)
+{
+    if (entries == 0 || entries > TLB_MAX_ENTRIES || associativity == 0 ||
+        entries % associativity != 0)
+        return false;
+    uint32_t sets = entries / associativity;
+    return (sets & (sets - 1)) == 0;
+}
+
+// Print and simulate a single demand access from the trace. `position` is the
+// index of the record within the trace. In multi-core mode, the access is
+// performed by the core given in the record.
+static int simulate_record(struct cache_system *cache_system, struct multicore_system *multicore,
+                           struct trace_record *record, size_t position, bool is_opt)
+{
+    if (multicore != NULL) {
+        if (cache_system->verbose) {
+            PROFILE_ENTER(PROFILE_OUTPUT);
+            printf("core %u %s at 0x%x\n", record->core, (record->rw == 'R' ? "read" : "write"),
+                   record->address);
+            PROFILE_EXIT();
+        }
+        return multicore_mem_access(multicore, record->core, record->address, record->rw);
+    }
+
+    if (cache_system->verbose) {
+        PROFILE_ENTER(PROFILE_OUTPUT);
+        printf("%s at 0x%x\n", (record->rw == 'R' ? "read" : "write"), record->address);
+        PROFILE_EXIT();
+    }
+    if (is_opt) {
+        opt_replacement_policy_advance(cache_system->replacement_policy, position);
+    }
+    return cache_system_mem_access(cache_system, record->address, record->rw, false);
+}
+
+// Simulate only the simpoints of the trace, each preceded by up to `warmup`
+// records whose statistics are discarded, and replace the statistics with the
+// estimate for the whole trace. The rest of the trace is only read (to check
+// that the simpoints were chosen for it).
+static int simulate_simpoints(struct cache_system *cache_system, struct simpoints *simpoints,
+                              struct trace_reader *reader, uint64_t warmup)
+{
+    struct trace_record record;
+    for (uint32_t i = 0; i < simpoints->count; i++) {
+        uint64_t start = simpoints->points[i].interval_index * simpoints->interval;
+        uint64_t warmup_start = start > warmup ? start - warmup : 0;
+        while (reader->position < warmup_start && trace_reader_next(reader, &record))
+            ;
+        while (reader->position < start && trace_reader_next(reader, &record)) {
+            if (simulate_record(cache_system, NULL, &record, reader->position - 1, false) != 0) {
+                return 1;
+            }
+        }
+
+        struct cache_system_stats before = cache_system->stats;
+        uint64_t end = start + simpoints->interval;
+        while (reader->position < end && trace_reader_next(reader, &record)) {
+            if (simulate_record(cache_system, NULL, &record, reader->position - 1, false) != 0) {
+                return 1;
+            }
+        }
+        cache_system_drain_write_buffer(cache_system);
+        uint64_t length = reader->position > start ? reader->position - start : 0;
+        simpoints_add(simpoints, i, length, &before, &cache_system->stats);
+    }
+    while (trace_reader_next(reader, &record))
+        ;
+
+    if (reader->position != simpoints->records || reader->hash != simpoints->hash) {
+        fprintf(stderr, "The simpoints were chosen for a different trace\n");
+        return 1;
+    }
+    simpoints_estimate(simpoints, &cache_system->stats);
+    return 0;
+}
 
 int main(int argc, char **argv)
 {
+    double start_time = monotonic_seconds();
+
+    // Subcommands
+    if (argc >= 2 && !strcmp(argv[1], "gen-trace")) {
+        return trace_gen_main(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "analyze")) {
+        return trace_analyze_main(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "serve")) {
+        return serve_main(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "feed")) {
+        return feed_main(argc - 1, argv + 1);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "simpoint")) {
+        return simpoint_main(argc - 1, argv + 1);
+    }
+
     // Parse the arguments.
-    if (argc != 7) {
+    if (argc < 7) {
         fprintf(stderr, "Incorrect number of arguments.\n");
         return 1;
     }
@@ -29,89 +165,667 @@ int main(int argc, char **argv)
     char *prefetch_strategy = argv[5];
     size_t prefetch_amount = strtol(argv[6], &endptr, 10);
 
+    // Parse the optional arguments.
+    enum results_format format = RESULTS_TEXT;
+    bool csv_header = true;
+    const char *trace_path = NULL;
+    uint32_t interval = 0;
+    const char *interval_out_path = NULL;
+    uint64_t warmup = 0;
+    bool warmup_given = false;
+    const char *checkpoint_save_path = NULL;
+    const char *checkpoint_load_path = NULL;
+    uint32_t sample_rate = 0;
+    uint32_t sample_seed = 0;
+    uint32_t num_cores = 0;
+    const char *llc_spec = NULL;
+    uint32_t num_threads = 0;
+    enum write_policy write_policy = WRITE_BACK;
+    bool write_allocate = true;
+    uint32_t write_buffer_entries = 0;
+    bool write_options = false;
+    uint32_t victim_entries = 0;
+    uint32_t stream_buffer_count = 0, stream_buffer_depth = 0;
+    bool prefetch_to_stream_buffers = false;
+    uint32_t sectors = 1;
+    struct timing_config timing_config = {0};
+    bool timing = false;
+    const char *simpoints_path = NULL;
+    struct tlb_config tlb_config = {0};
+    bool tlb = false;
+    uint32_t page_size = 4096;
+    enum prefetch_page_policy prefetch_pages = PREFETCH_PAGES_CROSS;
+    enum cache_index_function index_function = INDEX_BITS;
+    for (int i = 7; i < argc; i++) {
+        const char *value;
+        if ((value = option_value(argv[i], "format"))) {
+            if (!results_parse_format(value, &format)) {
+                fprintf(stderr, "Unknown output format %s\n", value);
+                return 1;
+            }
+        } else if ((value = option_value(argv[i], "trace"))) {
+            trace_path = value;
+        } else if (!strcmp(argv[i], "--no-header")) {
+            csv_header = false;
+        } else if ((value = option_value(argv[i], "interval"))) {
+            interval = strtol(value, &endptr, 10);
+        } else if ((value = option_value(argv[i], "interval-out"))) {
+            interval_out_path = value;
+        } else if ((value = option_value(argv[i], "warmup"))) {
+            warmup = strtoull(value, &endptr, 10);
+            warmup_given = true;
+        } else if ((value = option_value(argv[i], "checkpoint-save"))) {
+            checkpoint_save_path = value;
+        } else if ((value = option_value(argv[i], "checkpoint-load"))) {
+            checkpoint_load_path = value;
+        } else if ((value = option_value(argv[i], "sample-sets"))) {
+            sample_rate = strtol(value, &endptr, 10);
+        } else if ((value = option_value(argv[i], "sample-seed"))) {
+            sample_seed = strtoul(value, &endptr, 10);
+        } else if ((value = option_value(argv[i], "cores"))) {
+            num_cores = strtol(value, &endptr, 10);
+        } else if ((value = option_value(argv[i], "llc"))) {
+            llc_spec = value;
+        } else if ((value = option_value(argv[i], "threads"))) {
+            num_threads = strtol(value, &endptr, 10);
+        } else if ((value = option_value(argv[i], "write-policy"))) {
+            if (!strcmp(value, "wb")) {
+                write_policy = WRITE_BACK;
+            } else if (!strcmp(value, "wt")) {
+                write_policy = WRITE_THROUGH;
+            } else {
+                fprintf(stderr, "Unknown write policy %s\n", value);
+                return 1;
+            }
+            write_options = true;
+        } else if ((value = option_value(argv[i], "write-miss"))) {
+            if (!strcmp(value, "allocate")) {
+                write_allocate = true;
+            } else if (!strcmp(value, "no-allocate")) {
+                write_allocate = false;
+            } else {
+                fprintf(stderr, "Unknown write miss policy %s\n", value);
+                return 1;
+            }
+            write_options = true;
+        } else if ((value = option_value(argv[i], "write-buffer"))) {
+            write_buffer_entries = strtol(value, &endptr, 10);
+            write_options = true;
+        } else if ((value = option_value(argv[i], "victim-cache"))) {
+            victim_entries = strtol(value, &endptr, 10);
+        } else if ((value = option_value(argv[i], "stream-buffers"))) {
+            if (sscanf(value, "%u:%u", &stream_buffer_count, &stream_buffer_depth) != 2 ||
+                stream_buffer_count == 0 || stream_buffer_count > STREAM_BUFFER_MAX_BUFFERS ||
+                stream_buffer_depth == 0 || stream_buffer_depth > STREAM_BUFFER_MAX_DEPTH) {
+                fprintf(stderr, "--stream-buffers must be <buffers>:<depth> with at most %d "
+                                "buffers of depth at most %d\n",
+                        STREAM_BUFFER_MAX_BUFFERS, STREAM_BUFFER_MAX_DEPTH);
+                return 1;
+            }
+        } else if ((value = option_value(argv[i], "sectors"))) {
+            sectors = strtol(value, &endptr, 10);
+        } else if ((value = option_value(argv[i], "timing"))) {
+            if (sscanf(value, "%u:%u:%lf:%u", &timing_config.hit_latency,
+                       &timing_config.miss_latency, &timing_config.bandwidth,
+                       &timing_config.mshrs) != 4 ||
+                !(timing_config.bandwidth > 0) || timing_config.mshrs == 0 ||
+                timing_config.mshrs > TIMING_MAX_MSHRS) {
+                fprintf(stderr, "--timing must be <hit latency>:<miss latency>:<bytes per "
+                                "cycle>:<MSHRs> with at least one and at most %d MSHRs\n",
+                        TIMING_MAX_MSHRS);
+                return 1;
+            }
+            timing = true;
+        } else if ((value = option_value(argv[i], "tlb"))) {
+            if (sscanf(value, "%u:%u:%u:%u", &tlb_config.l1_entries,
+                       &tlb_config.l1_associativity, &tlb_config.l2_entries,
+                       &tlb_config.l2_associativity) != 4 ||
+                !tlb_geometry_valid(tlb_config.l1_entries, tlb_config.l1_associativity) ||
+                !tlb_geometry_valid(tlb_config.l2_entries, tlb_config.l2_associativity)) {
+                fprintf(stderr, "--tlb must be <L1 entries>:<L1 ways>:<L2 entries>:<L2 ways> "
+                                "with at most %d entries and a power-of-two number of sets "
+                                "per level\n",
+                        TLB_MAX_ENTRIES);
+                return 1;
+            }
+            tlb = true;
+        } else if ((value = option_value(argv[i], "page-size"))) {
+            page_size = strtoul(value, &endptr, 10);
+        } else if ((value = option_value(argv[i], "prefetch-pages"))) {
+            if (!strcmp(value, "cross")) {
+                prefetch_pages = PREFETCH_PAGES_CROSS;
+            } else if (!strcmp(value, "stop")) {
+                prefetch_pages = PREFETCH_PAGES_STOP;
+            } else if (!strcmp(value, "tlb")) {
+                prefetch_pages = PREFETCH_PAGES_TLB;
+            } else {
+                fprintf(stderr, "Unknown page policy for prefetches %s\n", value);
+                return 1;
+            }
+        } else if ((value = option_value(argv[i], "index"))) {
+            if (!strcmp(value, "bits")) {
+                index_function = INDEX_BITS;
+            } else if (!strcmp(value, "xor")) {
+                index_function = INDEX_XOR;
+            } else if (!strcmp(value, "prime")) {
+                index_function = INDEX_PRIME;
+            } else if (!strcmp(value, "skewed")) {
+                index_function = INDEX_SKEWED;
+            } else {
+                fprintf(stderr, "Unknown index function %s\n", value);
+                return 1;
+            }
+        } else if ((value = option_value(argv[i], "simpoints"))) {
+            simpoints_path = value;
+        } else if ((value = option_value(argv[i], "prefetch-target"))) {
+            if (!strcmp(value, "cache")) {
+                prefetch_to_stream_buffers = false;
+            } else if (!strcmp(value, "stream")) {
+                prefetch_to_stream_buffers = true;
+            } else {
+                fprintf(stderr, "Unknown prefetch target %s\n", value);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (format == RESULTS_CSV && interval > 0 && interval_out_path == NULL) {
+        fprintf(stderr, "--interval with --format=csv requires --interval-out\n");
+        return 1;
+    }
+
+    if (sample_rate > 1 && (checkpoint_save_path != NULL || checkpoint_load_path != NULL)) {
+        fprintf(stderr, "--sample-sets cannot be combined with checkpoints\n");
+        return 1;
+    }
+
+    if (num_cores > COHERENCE_MAX_CORES) {
+        fprintf(stderr, "At most %d cores are supported\n", COHERENCE_MAX_CORES);
+        return 1;
+    }
+    if (llc_spec != NULL && num_cores == 0) {
+        num_cores = 1;
+    }
+    if (num_cores > 0 &&
+        (!strcmp("OPT", replacement_policy_str) || checkpoint_save_path != NULL ||
+         checkpoint_load_path != NULL || sample_rate > 1 || interval > 0)) {
+        fprintf(stderr, "Multi-core mode cannot be combined with OPT, checkpoints, set "
+                        "sampling, or intervals\n");
+        return 1;
+    }
+
+    if (num_threads > PARALLEL_SIM_MAX_THREADS) {
+        fprintf(stderr, "At most %d threads are supported\n", PARALLEL_SIM_MAX_THREADS);
+        return 1;
+    }
+    if (num_threads > 1 &&
+        (!strcmp("OPT", replacement_policy_str) || num_cores > 0 ||
+         checkpoint_save_path != NULL || checkpoint_load_path != NULL || sample_rate > 1 ||
+         interval > 0)) {
+        fprintf(stderr, "--threads cannot be combined with OPT, multi-core mode, checkpoints, "
+                        "set sampling, or intervals\n");
+        return 1;
+    }
+
+    if (write_buffer_entries > WRITE_BUFFER_MAX_ENTRIES) {
+        fprintf(stderr, "The write buffer can have at most %d entries\n",
+                WRITE_BUFFER_MAX_ENTRIES);
+        return 1;
+    }
+    // The write buffer is shared by every set, so its state cannot be split
+    // across threads, and it is not part of a checkpoint. The coherence
+    // protocol assumes write-back with write-allocate.
+    if (write_buffer_entries > 0 &&
+        (num_threads > 1 || checkpoint_save_path != NULL || checkpoint_load_path != NULL)) {
+        fprintf(stderr, "--write-buffer cannot be combined with --threads or checkpoints\n");
+        return 1;
+    }
+    if (num_cores > 0 && (write_policy != WRITE_BACK || !write_allocate)) {
+        fprintf(stderr, "Multi-core mode requires write-back with write-allocate\n");
+        return 1;
+    }
+
+    if (victim_entries > VICTIM_CACHE_MAX_ENTRIES) {
+        fprintf(stderr, "The victim cache can have at most %d entries\n",
+                VICTIM_CACHE_MAX_ENTRIES);
+        return 1;
+    }
+    if (prefetch_to_stream_buffers && stream_buffer_count == 0) {
+        fprintf(stderr, "--prefetch-target=stream requires --stream-buffers\n");
+        return 1;
+    }
+    // The victim cache and the stream buffers are shared by every set, and
+    // they are not part of a checkpoint or of the coherence protocol.
+    if ((victim_entries > 0 || stream_buffer_count > 0) &&
+        (num_threads > 1 || num_cores > 0 || sample_rate > 1 || checkpoint_save_path != NULL ||
+         checkpoint_load_path != NULL)) {
+        fprintf(stderr, "--victim-cache and --stream-buffers cannot be combined with --threads, "
+                        "multi-core mode, set sampling, or checkpoints\n");
+        return 1;
+    }
+
+    if (sectors > 1 && (num_cores > 0 || victim_entries > 0 || stream_buffer_count > 0)) {
+        fprintf(stderr, "--sectors cannot be combined with multi-core mode, a victim cache, or "
+                        "stream buffers\n");
+        return 1;
+    }
+
+    // The timing model follows a single stream of accesses through the whole
+    // cache, so the accesses cannot be split up or skipped, and its in-flight
+    // misses are not part of a checkpoint.
+    if (timing && (num_threads > 1 || num_cores > 0 || sample_rate > 1 ||
+                   checkpoint_save_path != NULL || checkpoint_load_path != NULL)) {
+        fprintf(stderr, "--timing cannot be combined with --threads, multi-core mode, set "
+                        "sampling, or checkpoints\n");
+        return 1;
+    }
+
+    if (page_size < 4096 || (page_size & (page_size - 1))) {
+        fprintf(stderr, "The page size must be a power of two of at least 4096 bytes\n");
+        return 1;
+    }
+    if (prefetch_pages == PREFETCH_PAGES_TLB && !tlb) {
+        fprintf(stderr, "--prefetch-pages=tlb requires --tlb\n");
+        return 1;
+    }
+    // The TLB is shared by every set, and it is not part of a checkpoint. The
+    // page policy only applies to the first core, and the workers of a
+    // parallel run see the prefetches without the demand accesses that
+    // triggered them.
+    if ((tlb || prefetch_pages != PREFETCH_PAGES_CROSS) && (num_threads > 1 || num_cores > 0)) {
+        fprintf(stderr, "--tlb and --prefetch-pages cannot be combined with --threads or "
+                        "multi-core mode\n");
+        return 1;
+    }
+    if (tlb && (sample_rate > 1 || checkpoint_save_path != NULL || checkpoint_load_path != NULL)) {
+        fprintf(stderr, "--tlb cannot be combined with set sampling or checkpoints\n");
+        return 1;
+    }
+
+    // Skewed associativity replaces lines by age across the sets, so it has
+    // its own LRU scheme in place of the replacement policy, and a line is
+    // not tied to a single set.
+    if (index_function == INDEX_SKEWED &&
+        (strcmp("LRU", replacement_policy_str) || num_threads > 1 || sample_rate > 1 ||
+         checkpoint_save_path != NULL || checkpoint_load_path != NULL)) {
+        fprintf(stderr, "--index=skewed requires LRU, and cannot be combined with --threads, "
+                        "set sampling, or checkpoints\n");
+        return 1;
+    }
+
+    // The simpoints skip most of the trace, which OPT, the other cores, and
+    // the time-based statistics cannot account for.
+    struct simpoints *simpoints = NULL;
+    if (simpoints_path != NULL) {
+        if (!strcmp("OPT", replacement_policy_str) || num_threads > 1 || num_cores > 0 ||
+            checkpoint_save_path != NULL || checkpoint_load_path != NULL || sample_rate > 1 ||
+            interval > 0 || timing) {
+            fprintf(stderr, "--simpoints cannot be combined with OPT, --threads, multi-core "
+                            "mode, checkpoints, set sampling, intervals, or --timing\n");
+            return 1;
+        }
+        simpoints = simpoints_load(simpoints_path);
+        if (simpoints == NULL) {
+            return 1;
+        }
+        // By default, every simpoint is warmed up with the interval before it.
+        if (!warmup_given) {
+            warmup = simpoints->interval;
+        }
+    }
+
+    // The structured formats are meant to be consumed by other programs, so
+    // only print the results (and none of the per-access output).
+    bool verbose = format == RESULTS_TEXT;
+
+    FILE *trace_file = stdin;
+    if (trace_path != NULL) {
+        trace_file = fopen(trace_path, "r");
+        if (trace_file == NULL) {
+            perror(trace_path);
+            return 1;
+        }
+    }
+
     // NOTE: calculate the line size and number of sets.
     // check the values like if they are powers of 2.
     int line_size = cache_size / cache_lines;
     int sets = cache_lines / associativity;
+    if (!sets_valid(sets, index_function)) {
+        return 1;
+    }
 
     // Print out some parameter info
-    printf("Parameter Info\n");
-    printf("==============\n");
-    printf("Replacement Policy: %s\n", replacement_policy_str);
-    printf("Prefetch Strategy: %s\n", prefetch_strategy);
-    printf("Prefetch Amount: %ld\n", prefetch_amount);
-    printf("Cache Size: %ld\n", cache_size);
-    printf("Cache Lines: %ld\n", cache_lines);
-    printf("Associativity: %ld\n", associativity);
-    printf("Line Size: %dB\n", line_size);
-    printf("Number of Sets: %d\n", sets);
+    if (verbose) {
+        printf("Parameter Info\n");
+        printf("==============\n");
+        printf("Replacement Policy: %s\n", replacement_policy_str);
+        printf("Prefetch Strategy: %s\n", prefetch_strategy);
+        printf("Prefetch Amount: %ld\n", prefetch_amount);
+        printf("Cache Size: %ld\n", cache_size);
+        printf("Cache Lines: %ld\n", cache_lines);
+        printf("Associativity: %ld\n", associativity);
+        printf("Line Size: %dB\n", line_size);
+        printf("Number of Sets: %d\n", sets);
+    }
 
     // Instantiate the cache system.
+    // The workers of a parallel run would interleave their per-access output,
+    // so only the parameters and the results are printed.
     struct cache_system *cache_system = cache_system_new(line_size, sets, associativity);
+    cache_system->verbose = verbose && num_threads <= 1;
+    cache_system_set_index_function(cache_system, index_function);
+    if (verbose) {
+        cache_system_print_geometry(cache_system);
+    }
+    if (sectors == 0 || sectors > CACHE_MAX_SECTORS || (sectors & (sectors - 1)) ||
+        sectors > (uint32_t)line_size) {
+        fprintf(stderr, "The number of sectors must be a power of two, at most %d and at most "
+                        "the line size\n",
+                CACHE_MAX_SECTORS);
+        return 1;
+    }
+    cache_system_set_sectors(cache_system, sectors);
+    cache_system->write_policy = write_policy;
+    cache_system->write_allocate = write_allocate;
+    if (write_buffer_entries > 0) {
+        cache_system->write_buffer =
+            write_buffer_new(write_buffer_entries, line_size, CACHE_WORD_SIZE);
+    }
+    if (victim_entries > 0) {
+        cache_system->victim_cache = victim_cache_new(victim_entries);
+    }
+    if (stream_buffer_count > 0) {
+        cache_system->stream_buffers =
+            stream_buffers_new(stream_buffer_count, stream_buffer_depth, line_size);
+        cache_system->prefetch_to_stream_buffers = prefetch_to_stream_buffers;
+    }
+    if (timing) {
+        cache_system->timing = timing_model_new(&timing_config);
+    }
+    cache_system->page_bits = __builtin_ctz(page_size);
+    cache_system->prefetch_pages = prefetch_pages;
+    if (tlb) {
+        tlb_config.page_size = page_size;
+        cache_system->tlb = tlb_new(&tlb_config);
+    }
+    if (sample_rate > 1) {
+        cache_system->sampling = set_sampling_new(cache_system->num_sets, sample_rate, sample_seed);
+    }
+
+    // The OPT policy needs to look ahead in the trace, so it requires the whole
+    // trace to be loaded into memory up front. Otherwise, stream it from stdin.
+    bool is_opt = !strcmp("OPT", replacement_policy_str);
+    struct trace *trace = NULL;
+    if (is_opt) {
+        trace = trace_load(trace_file);
+        if (trace == NULL) return 1;
+    }
 
     // Instantiate the replacement policy
-    struct replacement_policy *replacement_policy;
-    if (!strcmp("LRU", replacement_policy_str)) {
-        replacement_policy =
-            lru_replacement_policy_new(cache_system->num_sets, cache_system->associativity);
-    } else if (!strcmp("RAND", replacement_policy_str)) {
-        replacement_policy =
-            rand_replacement_policy_new(cache_system->num_sets, cache_system->associativity);
-    } else if (!strcmp("LRU_PREFER_CLEAN", replacement_policy_str)) {
-        replacement_policy = lru_prefer_clean_replacement_policy_new(cache_system->num_sets,
-                                                                     cache_system->associativity);
-    } else {
-        fprintf(stderr, "Unknown replacement policy %s", replacement_policy_str);
+    struct replacement_policy *replacement_policy =
+        replacement_policy_new_named(replacement_policy_str, cache_system, trace);
+    if (replacement_policy == NULL) {
         return 1;
     }
-
     cache_system->replacement_policy = replacement_policy;
 
     // Instantiate the prefetcher
-    struct prefetcher *prefetcher;
-    if (!strcmp("NULL", prefetch_strategy)) {
-        prefetcher = null_prefetcher_new();
-    } else if (!strcmp("ADJACENT", prefetch_strategy)) {
-        prefetcher = adjacent_prefetcher_new();
-    } else if (!strcmp("SEQUENTIAL", prefetch_strategy)) {
-        prefetcher = sequential_prefetcher_new(prefetch_amount);
-    } else if (!strcmp("CUSTOM", prefetch_strategy)) {
-        prefetcher = custom_prefetcher_new();
-    } else {
-        fprintf(stderr, "Unknown replacement policy %s", prefetch_strategy);
+    struct prefetcher *prefetcher = prefetcher_new_named(prefetch_strategy, prefetch_amount);
+    if (prefetcher == NULL) {
         return 1;
     }
     cache_system->prefetcher = prefetcher;
 
+    // In multi-core mode, core 0 uses the cache system created above, and
+    // every other core gets an identical private cache system of its own.
+    struct multicore_system *multicore = NULL;
+    struct cache_system **cores = NULL;
+    struct cache_system *llc = NULL;
+    if (num_cores > 0) {
+        cores = calloc(num_cores, sizeof(struct cache_system *));
+        cores[0] = cache_system;
+        for (uint32_t i = 1; i < num_cores; i++) {
+            cores[i] = cache_system_new(line_size, sets, associativity);
+            cores[i]->verbose = verbose;
+            cache_system_set_index_function(cores[i], index_function);
+            cores[i]->replacement_policy =
+                replacement_policy_new_named(replacement_policy_str, cores[i], trace);
+            cores[i]->prefetcher = prefetcher_new_named(prefetch_strategy, prefetch_amount);
+        }
+
+        if (llc_spec != NULL) {
+            uint32_t llc_size, llc_lines, llc_associativity;
+            if (sscanf(llc_spec, "%u:%u:%u", &llc_size, &llc_lines, &llc_associativity) != 3 ||
+                llc_lines == 0 || llc_associativity == 0 || llc_size / llc_lines != line_size) {
+                fprintf(stderr, "--llc must be <size>:<lines>:<associativity> with the same line "
+                                "size as the private caches\n");
+                return 1;
+            }
+            if (!sets_valid(llc_lines / llc_associativity, index_function)) {
+                return 1;
+            }
+            llc = cache_system_new(line_size, llc_lines / llc_associativity, llc_associativity);
+            llc->verbose = false;
+            cache_system_set_index_function(llc, index_function);
+            llc->replacement_policy =
+                replacement_policy_new_named(replacement_policy_str, llc, trace);
+            llc->prefetcher = null_prefetcher_new();
+        }
+        multicore = multicore_system_new(cores, num_cores, llc);
+    }
+
+    // Partition the sets across worker threads. From here on, the accesses
+    // made through the cache system are routed to the workers.
+    struct parallel_sim *parallel = NULL;
+    if (num_threads > 1) {
+        parallel = parallel_sim_new(cache_system, num_threads);
+    }
+
     // Read the input and call the cache system mem_access function.
-    char rw = 0;
-    uint32_t address = 0;
-    while (scanf("%c %x\n", &rw, &address) >= 0) {
-        printf("%s at 0x%x\n", (rw == 'R' ? "read" : "write"), address);
-        if (cache_system_mem_access(cache_system, address, rw, false) != 0) {
+    struct trace_reader *reader = malloc(sizeof(struct trace_reader));
+    if (trace != NULL) {
+        trace_reader_init_trace(reader, trace);
+    } else {
+        trace_reader_init_file(reader, trace_file);
+    }
+    struct trace_record record;
+
+    // Resume from a checkpoint. The records that were simulated before the
+    // checkpoint was taken are skipped without being simulated, and they must
+    // be the ones the checkpoint was taken on.
+    struct checkpoint_config checkpoint_config = {
+        .replacement_policy = replacement_policy_str,
+        .prefetch_strategy = prefetch_strategy,
+        .prefetch_amount = prefetch_amount,
+    };
+    if (checkpoint_load_path != NULL) {
+        uint64_t resume_position, resume_hash;
+        if (checkpoint_load(checkpoint_load_path, cache_system, &checkpoint_config,
+                            &resume_position, &resume_hash) != 0) {
+            return 1;
+        }
+        while (reader->position < resume_position && trace_reader_next(reader, &record))
+            ;
+        if (reader->position != resume_position || reader->hash != resume_hash) {
+            fprintf(stderr, "Checkpoint %s was taken on a different trace\n",
+                    checkpoint_load_path);
+            return 1;
+        }
+    }
+
+    // Warm up the cache with the first `warmup` records, then discard the
+    // statistics gathered so far. The accessed-lines set is kept so that misses
+    // on lines touched during the warmup are not counted as compulsory.
+    if (warmup > 0 && simpoints == NULL) {
+        uint64_t warmup_end = reader->position + warmup;
+        while (reader->position < warmup_end && trace_reader_next(reader, &record)) {
+            if (simulate_record(cache_system, multicore, &record, reader->position - 1,
+                                is_opt) != 0) {
+                return 1;
+            }
+        }
+        memset(&cache_system->stats, 0, sizeof(struct cache_system_stats));
+        if (parallel != NULL) {
+            parallel_sim_reset_stats(parallel);
+        }
+        if (multicore != NULL) {
+            multicore_reset_stats(multicore);
+        }
+        if (cache_system->sampling != NULL) {
+            set_sampling_reset(cache_system->sampling);
+        }
+        if (cache_system->timing != NULL) {
+            timing_reset_stats(cache_system->timing);
+        }
+        if (verbose) {
+            printf("warmup complete after %lu records\n", (unsigned long)reader->position);
+        }
+
+        // Save the warmed-up state so that later runs can start from it.
+        if (checkpoint_save_path != NULL) {
+            if (checkpoint_save(checkpoint_save_path, cache_system, &checkpoint_config,
+                                reader->position, reader->hash) != 0) {
+                return 1;
+            }
+            checkpoint_save_path = NULL;
+        }
+    }
+
+    // Sample the statistics every `interval` demand accesses.
+    struct interval_stats *intervals = NULL;
+    uint64_t next_interval_sample = 0;
+    if (interval > 0) {
+        intervals = interval_stats_new(interval, trace ? trace->length / interval + 1 : 0);
+        interval_stats_restart(intervals, &cache_system->stats);
+        next_interval_sample = intervals->next_sample;
+    }
+
+    if (simpoints != NULL) {
+        if (simulate_simpoints(cache_system, simpoints, reader, warmup) != 0) {
             return 1;
         }
     }
+    while (trace_reader_next(reader, &record)) {
+        if (simulate_record(cache_system, multicore, &record, reader->position - 1, is_opt) != 0) {
+            return 1;
+        }
+        if (cache_system->stats.accesses == next_interval_sample && intervals != NULL) {
+            interval_stats_sample(intervals, &cache_system->stats);
+            next_interval_sample = intervals->next_sample;
+        }
+    }
+    if (reader->malformed) return 1;
+    PROFILE_FINISH();
+
+    // Wait for the workers and collect their statistics.
+    if (parallel != NULL && parallel_sim_finish(parallel) != 0) {
+        return 1;
+    }
+    cache_system_drain_write_buffer(cache_system);
+
+    // Without a warmup, the checkpoint holds the state at the end of the trace.
+    if (checkpoint_save_path != NULL) {
+        if (checkpoint_save(checkpoint_save_path, cache_system, &checkpoint_config,
+                            reader->position, reader->hash) != 0) {
+            return 1;
+        }
+    }
+
+    // Write out the interval time series.
+    if (intervals != NULL) {
+        interval_stats_finish(intervals, &cache_system->stats);
+        if (interval_out_path != NULL) {
+            FILE *interval_out = fopen(interval_out_path, "w");
+            if (interval_out == NULL) {
+                perror(interval_out_path);
+                return 1;
+            }
+            interval_stats_print_csv(interval_out, intervals);
+            fclose(interval_out);
+        }
+    }
 
     // Print the statistics
-    printf("\n\nStatistics\n");
-    printf("==========\n");
-    printf("OUTPUT ACCESSES %d\n", cache_system->stats.accesses);
-    printf("OUTPUT HITS %d\n", cache_system->stats.hits);
-    printf("OUTPUT MISSES %d\n", cache_system->stats.misses);
-    printf("OUTPUT PREFETCHES %d\n", cache_system->stats.prefetches);
-    printf("OUTPUT COMPULSORY MISSES %d\n", cache_system->stats.compulsory_misses);
-    printf("OUTPUT CONFLICT MISSES %d\n", cache_system->stats.conflict_misses);
-    printf("OUTPUT DIRTY EVICTIONS %d\n", cache_system->stats.dirty_evictions);
-    printf("OUTPUT HIT RATIO %.8f\n",
-           (double)cache_system->stats.hits / cache_system->stats.accesses);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    struct run_info info = {
+        .replacement_policy = replacement_policy_str,
+        .prefetch_strategy = prefetch_strategy,
+        .prefetch_amount = prefetch_amount,
+        .warmup = warmup,
+        .cache_size = cache_size,
+        .cache_lines = cache_lines,
+        .trace_path = trace_path != NULL ? trace_path : "-",
+        .trace_records = reader->position,
+        .trace_hash = reader->hash,
+        .wall_seconds = monotonic_seconds() - start_time,
+        .peak_rss_kb = usage.ru_maxrss,
+        .intervals = interval_out_path == NULL ? intervals : NULL,
+        .multicore = multicore,
+        .simpoints = simpoints,
+        .threads = num_threads > 1 ? num_threads : 1,
+        .traffic = write_options || sectors > 1,
+        .csv_header = csv_header,
+    };
+    if (multicore != NULL) {
+        // Report the totals over all of the cores as the main statistics.
+        struct cache_system total = *cache_system;
+        multicore_total_stats(multicore, &total.stats);
+        results_print(stdout, format, &total, &info);
+    } else {
+        results_print(stdout, format, cache_system, &info);
+    }
+    PROFILE_PRINT(stderr);
+    free(reader);
 
     // Clean everything up.
+    if (parallel != NULL) {
+        parallel_sim_cleanup(parallel);
+        free(parallel);
+    }
     cache_system_cleanup(cache_system);
     free(cache_system);
+    if (simpoints != NULL) {
+        simpoints_cleanup(simpoints);
+        free(simpoints);
+    }
 
     prefetcher->cleanup(prefetcher);
     free(prefetcher);
 
+    if (multicore != NULL) {
+        for (uint32_t i = 1; i < num_cores; i++) {
+            cores[i]->prefetcher->cleanup(cores[i]->prefetcher);
+            free(cores[i]->prefetcher);
+            cache_system_cleanup(cores[i]);
+            free(cores[i]);
+        }
+        if (llc != NULL) {
+            llc->prefetcher->cleanup(llc->prefetcher);
+            free(llc->prefetcher);
+            cache_system_cleanup(llc);
+            free(llc);
+        }
+        free(cores);
+        multicore_system_cleanup(multicore);
+        free(multicore);
+    }
+
+    if (trace != NULL) {
+        trace_cleanup(trace);
+        free(trace);
+    }
+    if (intervals != NULL) {
+        interval_stats_cleanup(intervals);
+        free(intervals);
+    }
+    if (trace_file != stdin) {
+        fclose(trace_file);
+    }
+
     return 0;
 }
@@ -3,7 +3,67 @@
 // memory_system.h.
 //
 
+#include <string.h>
+
 #include "memory_system.h"
+#include "coherence.h"
+#include "line_map.h"
+#include "parallel_sim.h"
+#include "profile.h"
+#include "stream_buffer.h"
+#include "timing.h"
+#include "tlb.h"
+#include "victim_cache.h"
+#include "write_buffer.h"
+
+#define STAT_FIELD(field)                                                                          \
+    {#field, offsetof(struct cache_system_stats, field),                                           \
+     sizeof(((struct cache_system_stats *)0)->field)}
+
+const struct cache_system_stat_field cache_system_stat_fields[] = {
+    STAT_FIELD(accesses),
+    STAT_FIELD(hits),
+    STAT_FIELD(misses),
+    STAT_FIELD(prefetches),
+    STAT_FIELD(compulsory_misses),
+    STAT_FIELD(conflict_misses),
+    STAT_FIELD(dirty_evictions),
+    STAT_FIELD(coherence_misses),
+    STAT_FIELD(bytes_read),
+    STAT_FIELD(prefetch_bytes_read),
+    STAT_FIELD(bytes_written),
+    STAT_FIELD(write_buffer_coalesced),
+    STAT_FIELD(victim_hits),
+    STAT_FIELD(stream_buffer_hits),
+    STAT_FIELD(stream_buffer_prefetches),
+    STAT_FIELD(sector_misses),
+    STAT_FIELD(tlb_misses),
+    STAT_FIELD(page_walks),
+    STAT_FIELD(prefetch_page_walks),
+    STAT_FIELD(dropped_prefetches),
+    STAT_FIELD(useful_prefetches),
+};
+
+const size_t cache_system_num_stat_fields =
+    sizeof(cache_system_stat_fields) / sizeof(cache_system_stat_fields[0]);
+
+uint64_t cache_system_stat(struct cache_system_stats *stats,
+                           const struct cache_system_stat_field *field)
+{
+    char *value = (char *)stats + field->offset;
+    return field->size == sizeof(uint64_t) ? *(uint64_t *)value : *(uint32_t *)value;
+}
+
+void cache_system_stat_set(struct cache_system_stats *stats,
+                           const struct cache_system_stat_field *field, uint64_t value)
+{
+    char *stat = (char *)stats + field->offset;
+    if (field->size == sizeof(uint64_t)) {
+        *(uint64_t *)stat = value;
+    } else {
+        *(uint32_t *)stat = (uint32_t)value;
+    }
+}
 
 struct cache_system *cache_system_new(uint32_t line_size, uint32_t sets, uint32_t associativity)
 {
@@ -11,8 +71,7 @@ struct cache_system *cache_system_new(uint32_t line_size, uint32_t sets, uint32_
     cs->line_size = line_size;
     cs->num_sets = sets;
     cs->associativity = associativity;
-    struct cache_system_stats stats = {0, 0, 0, 0, 0, 0, 0};
-    cs->stats = stats;
+    memset(&cs->stats, 0, sizeof(struct cache_system_stats));
 
     // NOTE: calculate the index bits, offset bits and tag bits.
     cs->index_bits = log2(sets);
@@ -21,13 +80,30 @@ struct cache_system *cache_system_new(uint32_t line_size, uint32_t sets, uint32_
 
     cs->offset_mask = 0xffffffff >> (32 - cs->offset_bits);
     cs->set_index_mask = 0xffffffff >> cs->tag_bits;
-
-    printf("\nCache System Geometry:\n");
-    printf("Index bits: %d\n", cs->index_bits);
-    printf("Offset bits: %d\n", cs->offset_bits);
-    printf("Tag bits: %d\n", cs->tag_bits);
-    printf("Offset mask: 0x%x\n", cs->offset_mask);
-    printf("Set index mask: 0x%x\n", cs->set_index_mask);
+    cs->index_function = INDEX_BITS;
+    cs->index_modulus = sets;
+    cs->line_last_use = NULL;
+    cs->clock = 0;
+    cs->verbose = true;
+    cs->sampling = NULL;
+    cs->unsampled_prefetches = 0;
+    cs->coherence = NULL;
+    cs->core_id = 0;
+    cs->parallel = NULL;
+    cs->write_policy = WRITE_BACK;
+    cs->write_allocate = true;
+    cs->write_buffer = NULL;
+    cs->victim_cache = NULL;
+    cs->stream_buffers = NULL;
+    cs->prefetch_to_stream_buffers = false;
+    cs->timing = NULL;
+    cs->tlb = NULL;
+    cs->page_bits = 12;
+    cs->prefetch_pages = PREFETCH_PAGES_CROSS;
+    cs->trigger_page = 0;
+    cs->sectors = 1;
+    cs->sector_size = line_size;
+    cs->sector_bits = cs->offset_bits;
 
     // We need to allocate an array of cache lines representing the cache lines
     // across all of the sets in the cache. We are using a single 1-D array
@@ -39,131 +115,518 @@ struct cache_system *cache_system_new(uint32_t line_size, uint32_t sets, uint32_
     cs->cache_lines = calloc(cs->num_sets * cs->associativity, sizeof(struct cache_line));
 
     // Allocate space to keep track of which lines were accessed.
-    cs->accessed_lines_hashtable = calloc(ACCESSED_HASHTABLE_SIZE, sizeof(struct accessed_line *));
+    cs->accessed_lines = line_map_new(4096);
     return cs;
 }
 
+void cache_system_set_sectors(struct cache_system *cs, uint32_t sectors)
+{
+    cs->sectors = sectors;
+    cs->sector_size = cs->line_size / sectors;
+    cs->sector_bits = log2(cs->sector_size);
+}
+
+// Returns the largest prime that is at most n (or 1 if there is none).
+static uint32_t largest_prime_at_most(uint32_t n)
+{
+    for (; n > 2; n--) {
+        bool prime = true;
+        for (uint32_t d = 2; d * d <= n && prime; d++) {
+            prime = n % d != 0;
+        }
+        if (prime) return n;
+    }
+    return n;
+}
+
+void cache_system_set_index_function(struct cache_system *cs,
+                                     enum cache_index_function index_function)
+{
+    cs->index_function = index_function;
+    cs->index_modulus = index_function == INDEX_PRIME ? largest_prime_at_most(cs->num_sets)
+                                                      : cs->num_sets;
+    if (index_function == INDEX_SKEWED) {
+        cs->line_last_use = calloc(cs->num_sets * cs->associativity, sizeof(uint64_t));
+    }
+}
+
+const char *cache_system_index_function_name(enum cache_index_function index_function)
+{
+    switch (index_function) {
+    case INDEX_BITS:
+        return "bits";
+    case INDEX_XOR:
+        return "xor";
+    case INDEX_PRIME:
+        return "prime";
+    case INDEX_SKEWED:
+        return "skewed";
+    }
+    return "unknown";
+}
+
+// The set of the line in way `way` with skewed associativity: the line ID,
+// mixed with a different seed for every way, goes through the murmur3
+// finalizer and the top index bits are kept.
+static uint32_t cache_system_skewed_set(struct cache_system *cs, uint32_t line_id, uint32_t way)
+{
+    if (cs->index_bits == 0) return 0;
+    uint32_t h = line_id ^ (way * 0x9e3779b9u);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h >> (32 - cs->index_bits);
+}
+
+uint32_t cache_system_set_index(struct cache_system *cs, uint32_t line_id)
+{
+    switch (cs->index_function) {
+    case INDEX_BITS:
+        break;
+    case INDEX_XOR: {
+        // Fold every index-sized chunk of the line ID onto the index, so that
+        // power-of-two strides larger than the cache still spread out.
+        uint32_t set_idx = 0;
+        for (uint32_t rest = line_id; rest != 0 && cs->index_bits > 0; rest >>= cs->index_bits) {
+            set_idx ^= rest & (cs->num_sets - 1);
+        }
+        return set_idx;
+    }
+    case INDEX_PRIME:
+        return line_id % cs->index_modulus;
+    case INDEX_SKEWED:
+        return cache_system_skewed_set(cs, line_id, 0);
+    }
+    return line_id & (cs->set_index_mask >> cs->offset_bits);
+}
+
+uint32_t cache_system_tag(struct cache_system *cs, uint32_t line_id)
+{
+    return cs->index_function == INDEX_BITS ? line_id >> cs->index_bits : line_id;
+}
+
+uint32_t cache_system_line_id(struct cache_system *cs, uint32_t set_idx, uint32_t tag)
+{
+    return cs->index_function == INDEX_BITS ? (tag << cs->index_bits) | set_idx : tag;
+}
+
+void cache_system_print_geometry(struct cache_system *cs)
+{
+    printf("\nCache System Geometry:\n");
+    printf("Index bits: %d\n", cs->index_bits);
+    printf("Offset bits: %d\n", cs->offset_bits);
+    printf("Tag bits: %d\n", cs->tag_bits);
+    printf("Offset mask: 0x%x\n", cs->offset_mask);
+    printf("Set index mask: 0x%x\n", cs->set_index_mask);
+    if (cs->index_function != INDEX_BITS) {
+        printf("Index function: %s\n", cache_system_index_function_name(cs->index_function));
+    }
+    if (cs->index_function == INDEX_PRIME) {
+        printf("Index modulus: %u\n", cs->index_modulus);
+    }
+}
+
 void cache_system_cleanup(struct cache_system *cache_system)
 {
     free(cache_system->cache_lines);
+    free(cache_system->line_last_use);
+    line_map_cleanup(cache_system->accessed_lines);
+    free(cache_system->accessed_lines);
     cache_system->replacement_policy->cleanup(cache_system->replacement_policy);
     free(cache_system->replacement_policy);
+    if (cache_system->sampling != NULL) {
+        set_sampling_cleanup(cache_system->sampling);
+        free(cache_system->sampling);
+    }
+    if (cache_system->write_buffer != NULL) {
+        write_buffer_cleanup(cache_system->write_buffer);
+        free(cache_system->write_buffer);
+    }
+    if (cache_system->victim_cache != NULL) {
+        victim_cache_cleanup(cache_system->victim_cache);
+        free(cache_system->victim_cache);
+    }
+    if (cache_system->stream_buffers != NULL) {
+        stream_buffers_cleanup(cache_system->stream_buffers);
+        free(cache_system->stream_buffers);
+    }
+    if (cache_system->timing != NULL) {
+        timing_model_cleanup(cache_system->timing);
+        free(cache_system->timing);
+    }
+    if (cache_system->tlb != NULL) {
+        tlb_cleanup(cache_system->tlb);
+        free(cache_system->tlb);
+    }
 }
 
-int cache_system_mem_access(struct cache_system *cache_system, uint32_t address, char rw,
-                            bool is_prefetch)
+// Send a write of the word at `offset` within the line to the next level.
+static void cache_system_write_next_level(struct cache_system *cache_system, uint32_t line_id,
+                                          uint32_t offset)
 {
-    if (is_prefetch)
-        printf("  prefetch: 0x%x\n", address);
-    else
-        cache_system->stats.accesses++;
+    if (cache_system->write_buffer != NULL) {
+        write_buffer_write(cache_system->write_buffer, line_id, offset / CACHE_WORD_SIZE,
+                           &cache_system->stats);
+    } else {
+        cache_system->stats.bytes_written += CACHE_WORD_SIZE;
+    }
+}
 
-    uint32_t offset = (address & cache_system->offset_mask);
-    uint32_t set_idx = (address & cache_system->set_index_mask) >> cache_system->offset_bits;
-    uint32_t tag = address >> (cache_system->offset_bits + cache_system->index_bits);
+// Fetch the line from the next level and store it in the set, evicting a line
+// if the set is full.
+static int cache_system_fill(struct cache_system *cache_system, uint32_t set_idx, uint32_t tag,
+                             uint32_t line_id, uint32_t sector, char rw, bool is_prefetch)
+{
+    // Look for the line in the victim cache and the stream buffers before
+    // fetching it from the next level.
+    enum cache_status restored = INVALID;
+    if (cache_system->victim_cache != NULL &&
+        victim_cache_take(cache_system->victim_cache, line_id, &restored)) {
+        if (cache_system->verbose) printf("  victim cache hit\n");
+        if (!is_prefetch) cache_system->stats.victim_hits++;
+    } else if (cache_system->stream_buffers != NULL &&
+               stream_buffers_take(cache_system->stream_buffers, line_id,
+                                   !cache_system->prefetch_to_stream_buffers,
+                                   &cache_system->stats)) {
+        if (cache_system->verbose) printf("  stream buffer hit\n");
+        if (!is_prefetch) cache_system->stats.stream_buffer_hits++;
+    } else {
+        cache_system->stats.bytes_read += cache_system->sector_size;
+        if (is_prefetch) cache_system->stats.prefetch_bytes_read += cache_system->sector_size;
 
-    // The line ID is the tag + the set_idx (everything except the offset).
-    uint32_t line_id = address >> cache_system->offset_bits;
+        // Unless the prefetcher fills them, a demand miss restarts a stream
+        // buffer at the next line.
+        if (cache_system->stream_buffers != NULL && !cache_system->prefetch_to_stream_buffers &&
+            !is_prefetch) {
+            stream_buffers_allocate(cache_system->stream_buffers, line_id + 1,
+                                    &cache_system->stats);
+        }
+    }
 
-    struct cache_line *cl = cache_system_find_cache_line(cache_system, set_idx, tag);
-    bool cache_miss = cl == NULL || cl->status == INVALID;
-    if (cache_miss) { // cache miss
-        printf("  0x%x miss\n", address);
-        if (!is_prefetch) {
-            cache_system->stats.misses++;
-            // Determine if it's a compulsory or conflict
-            if (cache_system_line_in_accessed_set(cache_system, line_id)) {
-                cache_system->stats.conflict_misses++;
-            } else {
-                cache_system->stats.compulsory_misses++;
-                cache_system_line_id_add(cache_system, line_id);
+    int insert_index = -1;
+    if (cache_system->index_function == INDEX_SKEWED) {
+        // Take the first candidate that is free, or else the least recently
+        // used one. Its way decides the set.
+        uint64_t oldest = UINT64_MAX;
+        for (uint32_t way = 0; way < cache_system->associativity; way++) {
+            uint32_t way_set = cache_system_skewed_set(cache_system, line_id, way);
+            uint32_t slot = way_set * cache_system->associativity + way;
+            uint64_t last_use = cache_system->cache_lines[slot].status == INVALID
+                                    ? 0
+                                    : cache_system->line_last_use[slot] + 1;
+            if (last_use < oldest) {
+                oldest = last_use;
+                insert_index = way;
+                set_idx = way_set;
             }
+            if (last_use == 0) break;
         }
-
+    } else {
         // See if there's an open index.
-        int insert_index = -1;
-        int set_start = set_idx * cache_system->associativity;
-        struct cache_line *start = &cache_system->cache_lines[set_start];
+        struct cache_line *start =
+            &cache_system->cache_lines[set_idx * cache_system->associativity];
         for (int i = 0; start + i < start + cache_system->associativity; i++) {
             if ((start + i)->status == INVALID) {
                 insert_index = i;
                 break;
             }
         }
+    }
+    int set_start = set_idx * cache_system->associativity;
 
-        if (insert_index < 0) {
-            // An eviction is necessary. Call the replacement policy's eviction
-            // index function.
-            int evicted_index = (*cache_system->replacement_policy->eviction_index)(
-                cache_system->replacement_policy, cache_system, set_idx);
+    if (insert_index < 0) {
+        // An eviction is necessary. Call the replacement policy's eviction
+        // index function.
+        PROFILE_ENTER(PROFILE_POLICY);
+        PROFILE_COUNT(PROFILE_POLICY_CALLS, 1);
+        int evicted_index = (*cache_system->replacement_policy->eviction_index)(
+            cache_system->replacement_policy, cache_system, set_idx);
+        PROFILE_EXIT();
 
-            // Check to ensure that the eviction index is within the set.
-            if (evicted_index < 0 || cache_system->associativity <= evicted_index) {
-                fprintf(stderr, "Eviction index %d is outside of the set!", evicted_index);
-                return 1;
-            }
+        // Check to ensure that the eviction index is within the set.
+        if (evicted_index < 0 || cache_system->associativity <= evicted_index) {
+            fprintf(stderr, "Eviction index %d is outside of the set!", evicted_index);
+            return 1;
+        }
 
-            // Check if the eviction requires writeback.
-            struct cache_line evicted = cache_system->cache_lines[set_start + evicted_index];
-            if (evicted.status == MODIFIED) {
-                cache_system->stats.dirty_evictions++;
-            }
+        // Use the evicted index as the insert index.
+        insert_index = evicted_index;
+    }
 
+    if (cache_system->cache_lines[set_start + insert_index].status != INVALID) {
+        // Check if the eviction requires writeback. With a victim cache, the
+        // line moves there instead, and the line it displaces is written back.
+        int evicted_index = insert_index;
+        struct cache_line evicted = cache_system->cache_lines[set_start + evicted_index];
+        uint32_t evicted_line_id = cache_system_line_id(cache_system, set_idx, evicted.tag);
+        struct victim_cache_entry displaced = {.status = evicted.status};
+        if (cache_system->victim_cache != NULL &&
+            !victim_cache_insert(cache_system->victim_cache, evicted_line_id, evicted.status,
+                                 &displaced)) {
+            displaced.status = INVALID;
+        }
+        if (displaced.status == MODIFIED) {
+            // Only the dirty sectors are written back. (The victim cache is
+            // not combined with sectoring, so its lines are written whole.)
+            cache_system->stats.dirty_evictions++;
+            cache_system->stats.bytes_written +=
+                cache_system->sectors > 1
+                    ? __builtin_popcount(evicted.dirty_sectors) * cache_system->sector_size
+                    : cache_system->line_size;
+        }
+        if (cache_system->coherence != NULL) {
+            coherence_evict(cache_system->coherence, cache_system->core_id, evicted_line_id,
+                            evicted.status);
+        }
+
+        if (cache_system->verbose) {
             printf("  evict %s cache line from set %d index %d\n",
                    (evicted.status == MODIFIED ? "dirty" : "clean"), set_idx, evicted_index);
+        }
+    }
 
-            // Use the evicted index as the insert index.
-            insert_index = evicted_index;
+    if (cache_system->verbose) {
+        printf("  store cache line with tag 0x%x in set %d index %d\n", tag, set_idx,
+               insert_index);
+    }
+
+    // Change the tag of the cache line.
+    struct cache_line *cl = &cache_system->cache_lines[set_start + insert_index];
+    cl->tag = tag;
+    cl->valid_sectors = sector;
+    if (cache_system->coherence != NULL) {
+        cl->status = coherence_fill(cache_system->coherence, cache_system->core_id, line_id, rw);
+    } else {
+        bool dirty =
+            (rw == 'W' && cache_system->write_policy == WRITE_BACK) || restored == MODIFIED;
+        cl->status = dirty ? MODIFIED : EXCLUSIVE;
+    }
+    cl->dirty_sectors = cl->status == MODIFIED ? sector : 0;
+    cl->prefetched = is_prefetch;
+    if (cache_system->line_last_use != NULL) {
+        cache_system->line_last_use[set_start + insert_index] = ++cache_system->clock;
+    }
+    return 0;
+}
+
+// Run the prefetcher after a demand access. Prefetches that were dropped at a
+// page boundary or that went to sets which are not sampled are not counted.
+static void cache_system_prefetch(struct cache_system *cache_system, uint32_t address,
+                                  bool is_miss)
+{
+    struct cache_system_stats *stats = &cache_system->stats;
+    uint64_t dropped = stats->dropped_prefetches;
+    uint32_t unsampled = cache_system->unsampled_prefetches;
+    PROFILE_ENTER(PROFILE_PREFETCH);
+    uint32_t issued = (*cache_system->prefetcher->handle_mem_access)(
+        cache_system->prefetcher, cache_system, address, is_miss);
+    PROFILE_EXIT();
+    stats->prefetches += issued - (stats->dropped_prefetches - dropped) -
+                         (cache_system->unsampled_prefetches - unsampled);
+}
+
+// Pass the outcome of an access to the timing model. `before` holds the
+// statistics from before the access, so the difference is the traffic it
+// caused. Stream buffer refills are not part of the fill of the accessed line.
+static void cache_system_time_access(struct cache_system *cache_system,
+                                     struct cache_system_stats *before, uint32_t line_id,
+                                     uint32_t sector, char rw, bool is_prefetch, bool hit)
+{
+    struct cache_system_stats *after = &cache_system->stats;
+    uint32_t background_bytes = (after->stream_buffer_prefetches -
+                                 before->stream_buffer_prefetches) * cache_system->line_size;
+    uint32_t fill_bytes = after->bytes_read - before->bytes_read - background_bytes;
+    timing_access(cache_system->timing, line_id, sector, rw, is_prefetch, hit, fill_bytes,
+                  background_bytes, after->bytes_written - before->bytes_written);
+}
+
+int cache_system_mem_access(struct cache_system *cache_system, uint32_t address, char rw,
+                            bool is_prefetch)
+{
+    if (!is_prefetch) PROFILE_COUNT(PROFILE_ACCESSES, 1);
+    if (cache_system->parallel != NULL) {
+        return parallel_sim_route(cache_system->parallel, address, rw, is_prefetch);
+    }
+
+    // Translate the address. A prefetch within the page of the demand access
+    // that triggered it shares its translation.
+    uint32_t page = address >> cache_system->page_bits;
+    if (!is_prefetch) {
+        cache_system->trigger_page = page;
+        if (cache_system->tlb != NULL) {
+            enum tlb_result result = tlb_translate(cache_system->tlb, address);
+            if (result != TLB_L1_HIT) cache_system->stats.tlb_misses++;
+            if (result == TLB_PAGE_WALK) cache_system->stats.page_walks++;
+        }
+    } else if (page != cache_system->trigger_page) {
+        if (cache_system->prefetch_pages == PREFETCH_PAGES_STOP) {
+            if (cache_system->verbose) printf("  drop prefetch: 0x%x\n", address);
+            cache_system->stats.dropped_prefetches++;
+            return 0;
         }
+        if (cache_system->prefetch_pages == PREFETCH_PAGES_TLB &&
+            tlb_translate(cache_system->tlb, address) == TLB_PAGE_WALK) {
+            cache_system->stats.prefetch_page_walks++;
+        }
+    }
+
+    if (is_prefetch && cache_system->verbose) printf("  prefetch: 0x%x\n", address);
+
+    // The line ID is the tag + the set_idx (everything except the offset).
+    uint32_t offset = (address & cache_system->offset_mask);
+    uint32_t line_id = address >> cache_system->offset_bits;
+    uint32_t set_idx = cache_system_set_index(cache_system, line_id);
+    uint32_t tag = cache_system_tag(cache_system, line_id);
+
+    // When sampling sets, accesses to the other sets are only counted, not
+    // simulated. A demand access to them still runs the prefetcher (as a hit,
+    // since its outcome is unknown), because its prefetches may go to sampled
+    // sets.
+    if (cache_system->sampling != NULL && !is_prefetch) {
+        set_sampling_access(cache_system->sampling, set_idx);
+    }
+    if (cache_system->sampling != NULL && !set_sampling_includes(cache_system->sampling, set_idx)) {
+        if (is_prefetch) {
+            cache_system->unsampled_prefetches++;
+        } else {
+            cache_system_prefetch(cache_system, address, false);
+        }
+        return 0;
+    }
+
+    if (!is_prefetch) cache_system->stats.accesses++;
+    struct cache_system_stats before = cache_system->stats;
 
-        printf("  store cache line with tag 0x%x in set %d index %d\n", tag, set_idx, insert_index);
+    if (is_prefetch) PROFILE_COUNT(PROFILE_PREFETCH_PROBES, 1);
+    PROFILE_ENTER(PROFILE_LOOKUP);
+    struct cache_line *cl = cache_system_find_cache_line(cache_system, set_idx, tag);
+    PROFILE_EXIT();
+    uint32_t sector = 1u << (offset >> cache_system->sector_bits);
+
+    // Prefetches that target the stream buffers never touch the main array.
+    if (is_prefetch && cache_system->prefetch_to_stream_buffers) {
+        if (cl == NULL && (cache_system->victim_cache == NULL ||
+                           !victim_cache_contains(cache_system->victim_cache, line_id))) {
+            stream_buffers_insert(cache_system->stream_buffers, line_id, &cache_system->stats);
+            if (cache_system->timing != NULL) {
+                // The prefetched line is in flight like any other fill.
+                timing_access(cache_system->timing, line_id, sector, rw, true, false,
+                              cache_system->stats.bytes_read - before.bytes_read, 0, 0);
+            }
+        }
+        return 0;
+    }
+    bool cache_miss = cl == NULL || !(cl->valid_sectors & sector);
+    if (cache_system->sampling != NULL && !is_prefetch && !cache_miss) {
+        set_sampling_hit(cache_system->sampling, set_idx);
+    }
+    if (cache_miss) { // cache miss
+        if (cache_system->verbose) printf("  0x%x miss\n", address);
+        if (!is_prefetch) {
+            cache_system->stats.misses++;
+            // Determine if it's a sector, coherence, compulsory, or conflict miss
+            if (cl != NULL) {
+                cache_system->stats.sector_misses++;
+            } else if (cache_system->coherence != NULL &&
+                coherence_take_invalidated(cache_system->coherence, cache_system->core_id,
+                                           line_id)) {
+                cache_system->stats.coherence_misses++;
+            } else if (cache_system_line_in_accessed_set(cache_system, line_id)) {
+                cache_system->stats.conflict_misses++;
+            } else {
+                cache_system->stats.compulsory_misses++;
+                cache_system_line_id_add(cache_system, line_id);
+            }
+        }
 
-        // Change the tag of the cache line, and set cl to this cache line.
-        cl = &cache_system->cache_lines[set_start + insert_index];
-        cl->tag = tag;
-        cl->status = (rw == 'W') ? MODIFIED : EXCLUSIVE;
+        // Without write-allocate, a write miss goes around the cache.
+        if (rw == 'W' && !cache_system->write_allocate) {
+            if (cache_system->verbose) printf("  write 0x%x around the cache\n", address);
+            cache_system_write_next_level(cache_system, line_id, offset);
+        } else {
+            if (cl != NULL) {
+                // The line is resident, so only the sector is fetched.
+                if (cache_system->verbose) printf("  fetch sector into resident line\n");
+                cl->valid_sectors |= sector;
+                cache_system->stats.bytes_read += cache_system->sector_size;
+                if (is_prefetch) {
+                    cache_system->stats.prefetch_bytes_read += cache_system->sector_size;
+                }
+                if (rw == 'W' && cache_system->write_policy == WRITE_BACK) {
+                    cl->status = MODIFIED;
+                    cl->dirty_sectors |= sector;
+                }
+            } else if (cache_system_fill(cache_system, set_idx, tag, line_id, sector, rw,
+                                         is_prefetch) != 0) {
+                return 1;
+            }
+            if (rw == 'W' && cache_system->write_policy == WRITE_THROUGH) {
+                cache_system_write_next_level(cache_system, line_id, offset);
+            }
+        }
     } else { // cache hit
-        printf("  0x%x hit: set %d, tag 0x%x, offset %d\n", address, set_idx, tag, offset);
-        if (!is_prefetch) cache_system->stats.hits++;
-        if (rw == 'W') cl->status = MODIFIED;
+        if (cache_system->verbose) {
+            printf("  0x%x hit: set %d, tag 0x%x, offset %d\n", address, set_idx, tag, offset);
+        }
+        if (!is_prefetch) {
+            cache_system->stats.hits++;
+            if (cl->prefetched) cache_system->stats.useful_prefetches++;
+            cl->prefetched = false;
+        }
+        if (rw == 'W' && cl->status == SHARED && cache_system->coherence != NULL) {
+            coherence_upgrade(cache_system->coherence, cache_system->core_id, line_id);
+        }
+        if (rw == 'W' && cache_system->write_policy == WRITE_BACK) {
+            cl->status = MODIFIED;
+            cl->dirty_sectors |= sector;
+        } else if (rw == 'W') {
+            cache_system_write_next_level(cache_system, line_id, offset);
+        }
     }
 
-    // Let the replacement policy know that the cache line was accessed.
-    (*cache_system->replacement_policy->cache_access)(cache_system->replacement_policy,
-                                                      cache_system, set_idx, tag);
+    // Let the replacement policy know that the cache line was accessed. With
+    // skewed associativity, the line is aged here instead (a fill already
+    // stamped the line it stored).
+    if (cache_system->index_function != INDEX_SKEWED) {
+        PROFILE_ENTER(PROFILE_POLICY);
+        PROFILE_COUNT(PROFILE_POLICY_CALLS, 1);
+        (*cache_system->replacement_policy->cache_access)(cache_system->replacement_policy,
+                                                          cache_system, set_idx, tag);
+        PROFILE_EXIT();
+    } else if (cl != NULL) {
+        cache_system->line_last_use[cl - cache_system->cache_lines] = ++cache_system->clock;
+    }
 
-    // Call the prefetcher if this isn't a prefetch.
-    if (!is_prefetch) {
-        cache_system->stats.prefetches += (*cache_system->prefetcher->handle_mem_access)(
-            cache_system->prefetcher, cache_system, address, cache_miss);
+    // The timing of the access is settled before the prefetches it triggers.
+    if (cache_system->timing != NULL) {
+        cache_system_time_access(cache_system, &before, line_id, sector, rw, is_prefetch,
+                                 !cache_miss);
     }
 
+    // Call the prefetcher if this isn't a prefetch.
+    if (!is_prefetch) cache_system_prefetch(cache_system, address, cache_miss);
+
     // Everything was successful.
     return 0;
 }
 
-void cache_system_line_id_add(struct cache_system *cache_system, uint32_t line_id)
+void cache_system_drain_write_buffer(struct cache_system *cache_system)
 {
-    int hashtable_idx = line_id % ACCESSED_HASHTABLE_SIZE;
-
-    struct accessed_line *new_accessed = malloc(sizeof(struct accessed_line));
-    new_accessed->line_id = line_id;
-    new_accessed->next = cache_system->accessed_lines_hashtable[hashtable_idx];
+    if (cache_system->write_buffer != NULL) {
+        write_buffer_drain(cache_system->write_buffer, &cache_system->stats);
+    }
+}
 
-    cache_system->accessed_lines_hashtable[hashtable_idx] = new_accessed;
+void cache_system_line_id_add(struct cache_system *cache_system, uint32_t line_id)
+{
+    line_map_put(cache_system->accessed_lines, line_id, 0);
 }
 
 bool cache_system_line_in_accessed_set(struct cache_system *cache_system, uint32_t line_id)
 {
-    int hashtable_idx = line_id % ACCESSED_HASHTABLE_SIZE;
-    struct accessed_line *current = cache_system->accessed_lines_hashtable[hashtable_idx];
-    while (current != NULL) {
-        if (current->line_id == line_id) {
-            return true; // This line was accessed before.
-        }
-        current = current->next;
-    }
-    return false; // If we got here, the ID we are looking for was not in the set.
+    return line_map_get(cache_system->accessed_lines, line_id) != NULL;
 }
 
 struct cache_line *cache_system_find_cache_line(struct cache_system *cache_system, uint32_t set_idx,
@@ -171,12 +634,33 @@ struct cache_line *cache_system_find_cache_line(struct cache_system *cache_syste
 {
     // NOTE: Return a pointer to the cache line within the given set that has
     // the given tag. If no such element exists, then return NULL.
+    PROFILE_COUNT(PROFILE_SET_SCANS, 1);
+    if (cache_system->index_function == INDEX_SKEWED) {
+        for (uint32_t way = 0; way < cache_system->associativity; way++) {
+            PROFILE_COUNT(PROFILE_WAYS_COMPARED, 1);
+            uint32_t way_set = cache_system_skewed_set(cache_system, tag, way);
+            struct cache_line *cl =
+                &cache_system->cache_lines[way_set * cache_system->associativity + way];
+            if (cl->tag == tag && cl->status != INVALID) return cl;
+        }
+        return NULL;
+    }
+
     int set_start = set_idx * cache_system->associativity;
     struct cache_line *start = &cache_system->cache_lines[set_start];
     for (int i = 0; start + i < start + cache_system->associativity; i++) {
-        if ((start + i)->tag == tag) {
+        // Invalid lines are skipped, since lines invalidated by another core
+        // keep their tag.
+        PROFILE_COUNT(PROFILE_WAYS_COMPARED, 1);
+        if ((start + i)->tag == tag && (start + i)->status != INVALID) {
             return start + i;
         }
     }
     return NULL;
 }
+
+struct cache_line *cache_system_lookup_line(struct cache_system *cache_system, uint32_t line_id)
+{
+    return cache_system_find_cache_line(cache_system, cache_system_set_index(cache_system, line_id),
+                                        cache_system_tag(cache_system, line_id));
+}
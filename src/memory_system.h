@@ -9,45 +9,114 @@
 
 #include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 struct replacement_policy;
 struct prefetcher;
+struct multicore_system;
+struct parallel_sim;
+struct write_buffer;
+struct victim_cache;
+struct stream_buffers;
+struct timing_model;
+struct tlb;
 #include "prefetchers.h"
 #include "replacement_policies.h"
+#include "set_sampling.h"
 
-#define ACCESSED_HASHTABLE_SIZE 4096
 
 // This struct contains statistics about the cache performance.
 struct cache_system_stats {
-    uint32_t accesses;          // Total number of cache accesses
-    uint32_t hits;              // Total number of cache hits
-    uint32_t misses;            // Total number of cache misses
-    uint32_t prefetches;        // Total number of prefetched cache lines
-    uint32_t compulsory_misses; // Total number of compulsory misses
-    uint32_t conflict_misses;   // Total number of conflict misses
-    uint32_t dirty_evictions;   // Total number of cache evictions requiring write-back
+    uint64_t accesses;                 // Total number of cache accesses
+    uint64_t hits;                     // Total number of cache hits
+    uint64_t misses;                   // Total number of cache misses
+    uint64_t prefetches;               // Total number of prefetched cache lines
+    uint64_t compulsory_misses;        // Total number of compulsory misses
+    uint64_t conflict_misses;          // Total number of conflict misses
+    uint64_t dirty_evictions;          // Total number of cache evictions requiring write-back
+    uint64_t coherence_misses;         // Misses on lines invalidated by another core
+    uint64_t bytes_read;               // Bytes fetched from the next level (all fills)
+    uint64_t prefetch_bytes_read;      // Bytes fetched from the next level by prefetches
+    uint64_t bytes_written;            // Bytes written to the next level
+    uint64_t write_buffer_coalesced;   // Writes merged into an entry already in the write buffer
+    uint64_t victim_hits;              // Misses in the main array that hit in the victim cache
+    uint64_t stream_buffer_hits;       // Misses in the main array that hit in a stream buffer
+    uint64_t stream_buffer_prefetches; // Lines fetched into the stream buffers
+    uint64_t sector_misses;            // Misses on absent sectors of resident lines
+    uint64_t tlb_misses;               // Demand accesses that missed in the L1 TLB
+    uint64_t page_walks;               // Demand accesses that missed in both TLB levels
+    uint64_t prefetch_page_walks;      // Page walks for prefetches into another page
+    uint64_t dropped_prefetches;       // Prefetches not issued since they crossed a page
+    uint64_t useful_prefetches;        // Prefetched lines later hit by a demand access
+};
+
+// Describes one field of struct cache_system_stats so that code which handles
+// every statistic (output formats, interval snapshots) can iterate over them.
+// Every statistic is a uint64_t, since long traces pass 2^32 accesses.
+struct cache_system_stat_field {
+    const char *name;
+    size_t offset; // Offset of the field within struct cache_system_stats
+    size_t size;   // sizeof the field: 4 or 8
+};
+
+extern const struct cache_system_stat_field cache_system_stat_fields[];
+extern const size_t cache_system_num_stat_fields;
+
+// Read or write the given field of the statistics.
+uint64_t cache_system_stat(struct cache_system_stats *stats,
+                           const struct cache_system_stat_field *field);
+void cache_system_stat_set(struct cache_system_stats *stats,
+                           const struct cache_system_stat_field *field, uint64_t value);
+
+// Size of a single access from the trace. Write-through stores and writes
+// around the cache transfer one word to the next level.
+#define CACHE_WORD_SIZE 4
+
+#define CACHE_MAX_SECTORS 32
+
+// What happens to the next level when a line is written.
+enum write_policy {
+    WRITE_BACK,    // The line is marked MODIFIED and written back when evicted.
+    WRITE_THROUGH, // Every write is sent to the next level, and lines stay clean.
+};
+
+// What happens to a prefetch into a different page than the demand access
+// that triggered it.
+enum prefetch_page_policy {
+    PREFETCH_PAGES_CROSS, // It is issued as if the translation were free.
+    PREFETCH_PAGES_STOP,  // It is dropped.
+    PREFETCH_PAGES_TLB,   // It translates through the TLB, walking the page table on a miss.
+};
+
+// How the set of a line is derived from its line ID.
+enum cache_index_function {
+    INDEX_BITS,   // The low index bits of the line ID.
+    INDEX_XOR,    // The line ID XOR-folded down to the index bits.
+    INDEX_PRIME,  // The line ID modulo the largest prime not above the number of sets.
+    INDEX_SKEWED, // A different hash of the line ID for every way (skewed associativity).
 };
 
 // This enum keeps track of the status of each cache line in a set.
 enum cache_status {
     INVALID,   // The cache line is invalid.
-    EXCLUSIVE, // The cache line is valid, and held exclusively by the current processor (no
-               // multi-processors).
+    EXCLUSIVE, // The cache line is valid, and held exclusively by the current processor.
     MODIFIED,  // The cache line is valid, and modified (requires write-back).
+    SHARED,    // The cache line is valid, clean, and may be held by other processors.
 };
 struct cache_line {
     uint32_t tag;
     enum cache_status status;
-};
 
-// This is a linked list struct for the hash table to keep track of what lines
-// have been accessed.
-struct accessed_line {
-    uint32_t line_id;
-    struct accessed_line *next;
+    // The sectors of the line that are present and that were written. Without
+    // sectoring, the whole line is a single sector (bit 0).
+    uint32_t valid_sectors;
+    uint32_t dirty_sectors;
+
+    // Whether the line was filled by a prefetch and no demand access hit it yet.
+    bool prefetched;
 };
 
 // This struct contains the data related to a cache system.
@@ -64,25 +133,115 @@ struct cache_system {
     // Masks and shifts
     uint32_t offset_mask, set_index_mask;
 
-    // Store the hash table as an array of linked lists.
-    struct accessed_line **accessed_lines_hashtable;
+    // The index function. Except with bit slicing, the tag of a line is its
+    // whole line ID. Prime-modulo indexing only uses the first `index_modulus`
+    // sets. With skewed associativity, way w of the set picked by the w-th
+    // hash is the only place a line can go in that way, so the candidates for
+    // a line are spread over several sets. They are replaced by age
+    // (`line_last_use`, stamped from `clock`) instead of by the replacement
+    // policy.
+    enum cache_index_function index_function;
+    uint32_t index_modulus;
+    uint64_t *line_last_use;
+    uint64_t clock;
+
+    // Sectoring: every line is split into `sectors` sectors of `sector_size`
+    // bytes, and misses only fetch the requested sector. Prefetchers work at
+    // the granularity of a sector. Without sectoring, there is one sector of
+    // `line_size` bytes.
+    uint32_t sectors, sector_size, sector_bits;
+
+    // The set of line IDs that have been accessed (the values are unused).
+    struct line_map *accessed_lines;
+
+    // Whether to print a line for every access, miss, eviction, and prefetch.
+    bool verbose;
+
+    // The write policies. Without write-allocate, a write miss is sent to the
+    // next level without filling the line. If `write_buffer` is not NULL,
+    // word writes to the next level go through it.
+    enum write_policy write_policy;
+    bool write_allocate;
+    struct write_buffer *write_buffer;
+
+    // Optional structures between the main array and the next level. If
+    // `prefetch_to_stream_buffers` is set, the prefetcher fills the stream
+    // buffers instead of the main array.
+    struct victim_cache *victim_cache;
+    struct stream_buffers *stream_buffers;
+    bool prefetch_to_stream_buffers;
+
+    // The pages of the virtual address space. If `tlb` is not NULL, demand
+    // accesses translate through it. `trigger_page` is the page of the current
+    // demand access, which its prefetches are compared against.
+    struct tlb *tlb;
+    uint32_t page_bits;
+    enum prefetch_page_policy prefetch_pages;
+    uint32_t trigger_page;
+
+    // If not NULL, the latency of every access is modeled.
+    struct timing_model *timing;
+
+    // If not NULL, only the sampled sets are simulated. Prefetches into the
+    // other sets are counted in `unsampled_prefetches` (which is not a
+    // statistic) so that they can be left out of `prefetches`.
+    struct set_sampling *sampling;
+    uint32_t unsampled_prefetches;
+
+    // If not NULL, this is the private cache of core `core_id` of a
+    // multi-core system, and it is kept coherent with the other cores.
+    struct multicore_system *coherence;
+    uint32_t core_id;
+
+    // If not NULL, the sets are simulated by worker threads and every access
+    // is routed to the worker owning its set.
+    struct parallel_sim *parallel;
 };
 
 // Create a new cache system.
 struct cache_system *cache_system_new(uint32_t line_size, uint32_t sets, uint32_t associativity);
 void cache_system_cleanup(struct cache_system *cache_system);
 
+// Split every line into `sectors` sectors (a power of two, at most
+// CACHE_MAX_SECTORS).
+void cache_system_set_sectors(struct cache_system *cache_system, uint32_t sectors);
+
+// Use the given index function. The number of sets must be a power of two,
+// except with prime-modulo indexing.
+void cache_system_set_index_function(struct cache_system *cache_system,
+                                     enum cache_index_function index_function);
+
+// Returns the name of the index function ("bits", "xor", "prime" or "skewed").
+const char *cache_system_index_function_name(enum cache_index_function index_function);
+
+// Map a line ID to its set index and tag, and back. With skewed
+// associativity, the set index is the one of way 0.
+uint32_t cache_system_set_index(struct cache_system *cache_system, uint32_t line_id);
+uint32_t cache_system_tag(struct cache_system *cache_system, uint32_t line_id);
+uint32_t cache_system_line_id(struct cache_system *cache_system, uint32_t set_idx, uint32_t tag);
+
+// Print the index/offset/tag breakdown of the cache system.
+void cache_system_print_geometry(struct cache_system *cache_system);
+
 // Perform updates to access memory
 int cache_system_mem_access(struct cache_system *cache_system, uint32_t address, char rw,
                             bool is_prefetch);
 
+// Drain the write buffer (if any) at the end of the simulation.
+void cache_system_drain_write_buffer(struct cache_system *cache_system);
+
 // Determine if a cache line has been accessed before.
 void cache_system_line_id_add(struct cache_system *cache_system, uint32_t line_id);
 bool cache_system_line_in_accessed_set(struct cache_system *cache_system, uint32_t line_id);
 
 // Returns a pointer to the cache line within the given set that has the given
-// tag. If no such element exists, then return NULL.
+// tag. If no such element exists, then return NULL. With skewed associativity,
+// every way is searched at its own set, and `set_idx` is ignored.
 struct cache_line *cache_system_find_cache_line(struct cache_system *cache_system, uint32_t set_idx,
                                                 uint32_t tag);
 
+// Returns a pointer to the valid cache line with the given line ID, or NULL if
+// the line is not in the cache.
+struct cache_line *cache_system_lookup_line(struct cache_system *cache_system, uint32_t line_id);
+
 #endif
@@ -0,0 +1,17 @@
+//
+// This file contains the implementations for the functions defined in
+// options.h.
+//
+
+#include <string.h>
+
+#include "options.h"
+
+const char *option_value(const char *arg, const char *name)
+{
+    size_t name_len = strlen(name);
+    if (strncmp(arg, "--", 2) || strncmp(arg + 2, name, name_len) || arg[2 + name_len] != '=') {
+        return NULL;
+    }
+    return arg + 3 + name_len;
+}
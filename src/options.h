@@ -0,0 +1,13 @@
+//
+// This file defines helpers for parsing the optional `--name=value` arguments
+// accepted by cachesim and its subcommands.
+//
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+// If `arg` has the form `--<name>=<value>`, return a pointer to the value.
+// Otherwise, return NULL.
+const char *option_value(const char *arg, const char *name);
+
+#endif
@@ -0,0 +1,191 @@
+//
+// This file contains the implementations for the functions defined in
+// parallel_sim.h.
+//
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "line_map.h"
+#include "parallel_sim.h"
+#include "prefetchers.h"
+#include "profile.h"
+
+#define PARALLEL_QUEUE_MASK (PARALLEL_QUEUE_SIZE - 1)
+
+static void parallel_queue_init(struct parallel_queue *queue)
+{
+    memset(queue, 0, sizeof(struct parallel_queue));
+    queue->ops = malloc(PARALLEL_QUEUE_SIZE * sizeof(struct parallel_op));
+}
+
+// Make every pushed entry visible to the consumer.
+static void parallel_queue_flush(struct parallel_queue *queue)
+{
+    atomic_store_explicit(&queue->tail, queue->local_tail, memory_order_release);
+}
+
+static void parallel_queue_push(struct parallel_queue *queue, struct parallel_op op)
+{
+    if (queue->local_tail - queue->cached_head == PARALLEL_QUEUE_SIZE) {
+        // The queue looks full. Publish everything so the consumer cannot be
+        // left waiting on entries we hold back, then wait for it to catch up.
+        parallel_queue_flush(queue);
+        while ((queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire)) ==
+               queue->local_tail - PARALLEL_QUEUE_SIZE) {
+            sched_yield();
+        }
+    }
+    queue->ops[queue->local_tail & PARALLEL_QUEUE_MASK] = op;
+    queue->local_tail++;
+    if ((queue->local_tail & (PARALLEL_QUEUE_BATCH - 1)) == 0) {
+        parallel_queue_flush(queue);
+    }
+}
+
+static void *parallel_worker_run(void *arg)
+{
+    struct parallel_worker *worker = arg;
+    struct parallel_queue *queue = &worker->queue;
+    struct cache_system *cache_system = &worker->cache_system;
+    uint64_t head = 0;
+    for (;;) {
+        uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head == tail) {
+            sched_yield();
+            continue;
+        }
+
+        for (; head != tail; head++) {
+            struct parallel_op *op = &queue->ops[head & PARALLEL_QUEUE_MASK];
+            switch (op->kind) {
+            case PARALLEL_OP_DEMAND:
+            case PARALLEL_OP_PREFETCH:
+                // After a failure, keep draining the queue so that the router
+                // never blocks, but stop simulating.
+                if (worker->status == 0) {
+                    worker->status = cache_system_mem_access(cache_system, op->address, op->rw,
+                                                             op->kind == PARALLEL_OP_PREFETCH);
+                }
+                break;
+            case PARALLEL_OP_RESET_STATS:
+                memset(&cache_system->stats, 0, sizeof(struct cache_system_stats));
+                break;
+            case PARALLEL_OP_END:
+                return NULL;
+            }
+        }
+        atomic_store_explicit(&queue->head, head, memory_order_release);
+    }
+}
+
+struct parallel_sim *parallel_sim_new(struct cache_system *cache_system, uint32_t num_threads)
+{
+    struct parallel_sim *sim = calloc(1, sizeof(struct parallel_sim));
+    sim->cache_system = cache_system;
+    sim->num_workers = num_threads;
+    sim->workers = calloc(num_threads, sizeof(struct parallel_worker));
+
+    for (uint32_t i = 0; i < num_threads; i++) {
+        struct parallel_worker *worker = &sim->workers[i];
+        parallel_queue_init(&worker->queue);
+
+        // The prefetcher runs on the router, so the workers never prefetch.
+        worker->cache_system = *cache_system;
+        memset(&worker->cache_system.stats, 0, sizeof(struct cache_system_stats));
+        worker->cache_system.accessed_lines = line_map_new(4096);
+        worker->cache_system.prefetcher = null_prefetcher_new();
+        worker->cache_system.verbose = false;
+
+        pthread_create(&worker->thread, NULL, parallel_worker_run, worker);
+    }
+
+    cache_system->parallel = sim;
+    return sim;
+}
+
+void parallel_sim_cleanup(struct parallel_sim *sim)
+{
+    for (uint32_t i = 0; i < sim->num_workers; i++) {
+        struct parallel_worker *worker = &sim->workers[i];
+        free(worker->queue.ops);
+        line_map_cleanup(worker->cache_system.accessed_lines);
+        free(worker->cache_system.accessed_lines);
+        worker->cache_system.prefetcher->cleanup(worker->cache_system.prefetcher);
+        free(worker->cache_system.prefetcher);
+    }
+    free(sim->workers);
+}
+
+int parallel_sim_route(struct parallel_sim *sim, uint32_t address, char rw, bool is_prefetch)
+{
+    struct cache_system *cache_system = sim->cache_system;
+    uint32_t set_idx =
+        cache_system_set_index(cache_system, address >> cache_system->offset_bits);
+    struct parallel_op op = {
+        .address = address,
+        .rw = rw,
+        .kind = is_prefetch ? PARALLEL_OP_PREFETCH : PARALLEL_OP_DEMAND,
+    };
+    parallel_queue_push(&sim->workers[set_idx % sim->num_workers].queue, op);
+
+    // The prefetcher calls back into cache_system_mem_access, which routes the
+    // prefetches right behind the demand access.
+    if (!is_prefetch) {
+        PROFILE_ENTER(PROFILE_PREFETCH);
+        cache_system->stats.prefetches += (*cache_system->prefetcher->handle_mem_access)(
+            cache_system->prefetcher, cache_system, address, false);
+        PROFILE_EXIT();
+    }
+    return 0;
+}
+
+// Push `kind` to every worker and publish it.
+static void parallel_sim_broadcast(struct parallel_sim *sim, enum parallel_op_kind kind)
+{
+    struct parallel_op op = {.kind = kind};
+    for (uint32_t i = 0; i < sim->num_workers; i++) {
+        parallel_queue_push(&sim->workers[i].queue, op);
+        parallel_queue_flush(&sim->workers[i].queue);
+    }
+}
+
+void parallel_sim_reset_stats(struct parallel_sim *sim)
+{
+    parallel_sim_broadcast(sim, PARALLEL_OP_RESET_STATS);
+    memset(&sim->cache_system->stats, 0, sizeof(struct cache_system_stats));
+}
+
+int parallel_sim_finish(struct parallel_sim *sim)
+{
+    struct cache_system *cache_system = sim->cache_system;
+    parallel_sim_broadcast(sim, PARALLEL_OP_END);
+
+    int status = 0;
+    for (uint32_t i = 0; i < sim->num_workers; i++) {
+        struct parallel_worker *worker = &sim->workers[i];
+        pthread_join(worker->thread, NULL);
+        status |= worker->status;
+
+        // The router only counts prefetches, and the workers count everything
+        // else, so the statistics can simply be summed.
+        for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+            const struct cache_system_stat_field *field = &cache_system_stat_fields[f];
+            cache_system_stat_set(&cache_system->stats, field,
+                                  cache_system_stat(&cache_system->stats, field) +
+                                      cache_system_stat(&worker->cache_system.stats, field));
+        }
+
+        struct line_map *accessed = worker->cache_system.accessed_lines;
+        for (size_t e = 0; e < accessed->capacity; e++) {
+            if (accessed->entries[e].used) {
+                cache_system_line_id_add(cache_system, accessed->entries[e].key);
+            }
+        }
+    }
+
+    cache_system->parallel = NULL;
+    return status;
+}
@@ -0,0 +1,106 @@
+//
+// This file defines the structs and function signatures for set-partitioned
+// parallel simulation of a single cache configuration.
+//
+// Accesses to different sets are independent, so the sets are partitioned
+// across worker threads (set `s` belongs to worker `s % num_workers`). The main
+// thread becomes a router: it parses the trace, decodes the set index of every
+// demand access, and pushes the access onto the owning worker's single-producer
+// single-consumer queue. It also runs the prefetcher, and forwards every
+// prefetch request to the worker owning the prefetched set right after the
+// demand access that triggered it. Every worker therefore sees the accesses to
+// its sets in the same order as the serial simulation, so the final statistics
+// are identical for deterministic replacement policies.
+//
+// The router runs the prefetcher without knowing whether the demand access hit
+// (it always passes `is_miss = false`). None of the built-in prefetchers use
+// that argument.
+//
+// The workers share the cache lines and the replacement policy state of the
+// routed cache system (each only touches its own sets) and keep their own
+// statistics and accessed-lines sets, which are merged by parallel_sim_finish.
+//
+
+#ifndef PARALLEL_SIM_H
+#define PARALLEL_SIM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "memory_system.h"
+
+#define PARALLEL_SIM_MAX_THREADS 256
+#define PARALLEL_QUEUE_SIZE 65536 // Entries per queue (a power of two)
+#define PARALLEL_QUEUE_BATCH 256  // Entries pushed before they are published
+
+enum parallel_op_kind {
+    PARALLEL_OP_DEMAND,
+    PARALLEL_OP_PREFETCH,
+    PARALLEL_OP_RESET_STATS,
+    PARALLEL_OP_END,
+};
+
+struct parallel_op {
+    uint32_t address;
+    char rw;
+    uint8_t kind;
+};
+
+// A bounded single-producer single-consumer ring buffer. The indices only ever
+// increase; an index is masked when it is used to access `ops`. The producer
+// publishes its entries in batches to keep the shared cache lines quiet.
+struct parallel_queue {
+    struct parallel_op *ops;
+
+    // Written by the consumer.
+    _Atomic uint64_t head;
+    char head_padding[64 - sizeof(uint64_t)];
+
+    // Written by the producer.
+    _Atomic uint64_t tail;
+    char tail_padding[64 - sizeof(uint64_t)];
+
+    // Private to the producer.
+    uint64_t local_tail;
+    uint64_t cached_head;
+};
+
+struct parallel_worker {
+    pthread_t thread;
+    struct parallel_queue queue;
+
+    // A copy of the routed cache system that shares its cache lines and
+    // replacement policy, with its own statistics and accessed-lines set.
+    struct cache_system cache_system;
+
+    int status; // Non-zero if an access failed
+};
+
+struct parallel_sim {
+    struct cache_system *cache_system; // The routed cache system
+    uint32_t num_workers;
+    struct parallel_worker *workers;
+};
+
+// Start `num_threads` workers for the given cache system, which must already
+// have its replacement policy and prefetcher. From now on,
+// cache_system_mem_access on the cache system routes the access to a worker.
+struct parallel_sim *parallel_sim_new(struct cache_system *cache_system, uint32_t num_threads);
+void parallel_sim_cleanup(struct parallel_sim *sim);
+
+// Called by cache_system_mem_access for a routed cache system.
+int parallel_sim_route(struct parallel_sim *sim, uint32_t address, char rw, bool is_prefetch);
+
+// Reset the statistics of the workers once they have simulated every access
+// routed so far (used at the end of the warmup).
+void parallel_sim_reset_stats(struct parallel_sim *sim);
+
+// Wait for the workers to simulate every routed access, stop them, and merge
+// their statistics and accessed-lines sets into the cache system, which is
+// no longer routed afterwards.
+// Returns: 0 on success, non-zero if any access failed.
+int parallel_sim_finish(struct parallel_sim *sim);
+
+#endif
@@ -3,6 +3,8 @@
 // cache systems and defines the prefetcher struct.
 //
 
+#include <string.h>
+
 #include "prefetchers.h"
 
 // Null Prefetcher
@@ -47,14 +49,15 @@ uint32_t sequential_handle_mem_access(struct prefetcher *prefetcher,
         return 0;
     }
 
-    // Calculate the next sequential addresses to prefetch
-    uint32_t line_size = cache_system->line_size;
+    // Calculate the next sequential addresses to prefetch. Prefetches are
+    // issued per sector, which is the whole line unless the cache is sectored.
+    uint32_t block_size = cache_system->sector_size;
     uint32_t lines_prefetched = 0;
 
     for (uint32_t i = 1; i <= prefetch_amount; i++)
     {
-        // Calculate the next sequential address (current address + i * line_size)
-        uint32_t next_address = address + (i * line_size);
+        // Calculate the next sequential address (current address + i * block_size)
+        uint32_t next_address = address + (i * block_size);
 
         // Perform the prefetch by calling cache_system_mem_access with is_prefetch=true
         if (cache_system_mem_access(cache_system, next_address, 'R', true) == 0)
@@ -92,12 +95,13 @@ uint32_t adjacent_handle_mem_access(struct prefetcher *prefetcher,
                                     struct cache_system *cache_system, uint32_t address,
                                     bool is_miss)
 {
-    // Get the cache line size to calculate the next address
-    uint32_t line_size = cache_system->line_size;
+    // Get the prefetch granularity (the sector size, which is the line size
+    // unless the cache is sectored) to calculate the next address
+    uint32_t block_size = cache_system->sector_size;
     uint32_t lines_prefetched = 0;
 
-    // Prefetch the line after the current one (the adjacent line)
-    uint32_t next_address = address + line_size;
+    // Prefetch the block after the current one (the adjacent block)
+    uint32_t next_address = address + block_size;
     if (cache_system_mem_access(cache_system, next_address, 'R', true) == 0)
     {
         lines_prefetched++;
@@ -192,11 +196,13 @@ uint32_t custom_handle_mem_access(struct prefetcher *prefetcher, struct cache_sy
                                   uint32_t address, bool is_miss)
 {
     struct custom_data *data = (struct custom_data *)prefetcher->data;
-    uint32_t line_size = cache_system->line_size;
+    // Streams are tracked per sector, which is the whole line unless the cache
+    // is sectored.
+    uint32_t block_size = cache_system->sector_size;
     uint32_t lines_prefetched = 0;
 
-    // Align address to cache line boundary
-    uint32_t line_address = address - (address % line_size);
+    // Align address to cache line (sector) boundary
+    uint32_t line_address = address - (address % block_size);
 
     // Find or allocate a stream for this address
     struct stream_entry *stream = find_or_allocate_stream(data, line_address);
@@ -250,6 +256,17 @@ uint32_t custom_handle_mem_access(struct prefetcher *prefetcher, struct cache_sy
     return lines_prefetched;
 }
 
+int custom_save(struct prefetcher *prefetcher, FILE *file)
+{
+    // Save the whole stream table along with the replacement pointer
+    return fwrite(prefetcher->data, sizeof(struct custom_data), 1, file) != 1;
+}
+
+int custom_load(struct prefetcher *prefetcher, FILE *file)
+{
+    return fread(prefetcher->data, sizeof(struct custom_data), 1, file) != 1;
+}
+
 void custom_cleanup(struct prefetcher *prefetcher)
 {
     // Free the custom_data struct that was allocated
@@ -261,6 +278,8 @@ struct prefetcher *custom_prefetcher_new()
     struct prefetcher *custom_prefetcher = calloc(1, sizeof(struct prefetcher));
     custom_prefetcher->handle_mem_access = &custom_handle_mem_access;
     custom_prefetcher->cleanup = &custom_cleanup;
+    custom_prefetcher->save = &custom_save;
+    custom_prefetcher->load = &custom_load;
 
     // Allocate and initialize data for the custom prefetcher
     struct custom_data *data = calloc(1, sizeof(struct custom_data));
@@ -278,3 +297,27 @@ struct prefetcher *custom_prefetcher_new()
     custom_prefetcher->data = data;
     return custom_prefetcher;
 }
+
+// Construction by name
+// ============================================================================
+struct prefetcher *prefetcher_new_named(const char *name, uint32_t prefetch_amount)
+{
+    if (!strcmp("NULL", name))
+    {
+        return null_prefetcher_new();
+    }
+    else if (!strcmp("ADJACENT", name))
+    {
+        return adjacent_prefetcher_new();
+    }
+    else if (!strcmp("SEQUENTIAL", name))
+    {
+        return sequential_prefetcher_new(prefetch_amount);
+    }
+    else if (!strcmp("CUSTOM", name))
+    {
+        return custom_prefetcher_new();
+    }
+    fprintf(stderr, "Unknown prefetch strategy %s", name);
+    return NULL;
+}
@@ -7,6 +7,7 @@
 #define PREFETCHERS_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -46,6 +47,16 @@ struct prefetcher {
     //  * prefetcher: the instance of prefetcher to clean up
     void (*cleanup)(struct prefetcher *prefetcher);
 
+    // These functions write the state of the prefetcher to a checkpoint file
+    // and read it back. They may be NULL if the prefetcher has no state.
+    //
+    // Arguments:
+    //  * prefetcher: the instance of the prefetcher
+    //  * file: the checkpoint file, positioned where the state belongs
+    // Returns: 0 on success, non-zero on failure
+    int (*save)(struct prefetcher *prefetcher, FILE *file);
+    int (*load)(struct prefetcher *prefetcher, FILE *file);
+
     // Use this pointer to store any data that the prefetcher needs.
     void *data;
 };
@@ -56,4 +67,8 @@ struct prefetcher *adjacent_prefetcher_new();
 struct prefetcher *sequential_prefetcher_new(uint32_t prefetch_amount);
 struct prefetcher *custom_prefetcher_new();
 
+// Instantiate the prefetcher with the given name ("NULL", "ADJACENT",
+// "SEQUENTIAL", or "CUSTOM"). Returns NULL if the name is unknown.
+struct prefetcher *prefetcher_new_named(const char *name, uint32_t prefetch_amount);
+
 #endif
@@ -0,0 +1,101 @@
+//
+// This file contains the implementations for the functions defined in
+// profile.h. Without CACHESIM_PROFILE, it is empty.
+//
+
+#ifdef CACHESIM_PROFILE
+
+#include <time.h>
+
+#include "profile.h"
+
+_Thread_local struct profile profile;
+
+static const char *profile_phase_names[PROFILE_NUM_PHASES] = {
+    "simulate", "parse", "lookup", "policy", "prefetch", "output",
+};
+
+static uint64_t profile_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Charge the time since the last charge to the innermost phase.
+static void profile_charge(uint64_t now)
+{
+    enum profile_phase phase = profile.depth > 0 ? profile.stack[profile.depth - 1]
+                                                 : PROFILE_SIMULATE;
+    profile.phase_ns[phase] += now - profile.last_ns;
+    profile.last_ns = now;
+}
+
+void profile_window(void)
+{
+    // Windows start outside of every phase, so the stack is empty.
+    if (profile.timed) profile_charge(profile_now_ns());
+    profile.timed = profile.windows++ % PROFILE_SAMPLE_PERIOD == 0;
+    if (profile.timed) {
+        profile.timed_windows++;
+        profile.last_ns = profile_now_ns();
+    }
+}
+
+void profile_push(enum profile_phase phase)
+{
+    profile_charge(profile_now_ns());
+    profile.stack[profile.depth++] = phase;
+}
+
+void profile_pop(void)
+{
+    profile_charge(profile_now_ns());
+    profile.depth--;
+}
+
+void profile_finish(void)
+{
+    uint64_t now = profile_now_ns();
+    if (profile.timed) profile_charge(now);
+    profile.timed = false;
+    profile.finish_ns = now;
+}
+
+void profile_print(FILE *out)
+{
+    double scale =
+        profile.timed_windows > 0 ? (double)profile.windows / profile.timed_windows : 0.0;
+    double seconds[PROFILE_NUM_PHASES];
+    double total = 0;
+    for (int i = 0; i < PROFILE_NUM_PHASES; i++) {
+        seconds[i] = profile.phase_ns[i] * scale / 1e9;
+        total += seconds[i];
+    }
+    double finish = profile.finish_ns > 0 ? (profile_now_ns() - profile.finish_ns) / 1e9 : 0.0;
+    total += finish;
+
+    // The summary goes after the results.
+    fflush(stdout);
+    fprintf(out, "\nProfile (1 in %d records timed, %lu of %lu)\n", PROFILE_SAMPLE_PERIOD,
+            (unsigned long)profile.timed_windows, (unsigned long)profile.windows);
+    for (int i = 0; i < PROFILE_NUM_PHASES; i++) {
+        fprintf(out, "  %-10s %10.6f s %6.2f%%\n", profile_phase_names[i], seconds[i],
+                total > 0 ? 100 * seconds[i] / total : 0.0);
+    }
+    fprintf(out, "  %-10s %10.6f s %6.2f%%\n", "finish", finish,
+            total > 0 ? 100 * finish / total : 0.0);
+    fprintf(out, "  %-10s %10.6f s\n", "total", total);
+
+    double accesses = profile.counters[PROFILE_ACCESSES];
+    if (accesses == 0) accesses = 1;
+    fprintf(out, "Per demand access (%lu accesses):\n",
+            (unsigned long)profile.counters[PROFILE_ACCESSES]);
+    fprintf(out, "  set scans       %.3f\n", profile.counters[PROFILE_SET_SCANS] / accesses);
+    fprintf(out, "  ways compared   %.3f\n", profile.counters[PROFILE_WAYS_COMPARED] / accesses);
+    fprintf(out, "  policy calls    %.3f\n", profile.counters[PROFILE_POLICY_CALLS] / accesses);
+    fprintf(out, "  prefetch probes %.3f\n",
+            profile.counters[PROFILE_PREFETCH_PROBES] / accesses);
+}
+
+#endif
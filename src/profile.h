@@ -0,0 +1,106 @@
+//
+// This file defines the built-in profiler of the simulator's hot path. It is
+// only compiled in when CACHESIM_PROFILE is defined (`make PROFILE=1`);
+// otherwise every PROFILE_* macro expands to nothing.
+//
+// Time is attributed to phases: parsing the trace, the set lookup, the
+// replacement policy, the prefetcher, per-access output, and the rest of the
+// simulation. Every trace record starts a new sample window, and only one
+// window in PROFILE_SAMPLE_PERIOD is timed, so the clock is read a few times
+// per timed record and not at all for the others. The time of each phase is
+// exclusive of the phases nested in it (e.g. the prefetcher's time does not
+// include the lookups of the prefetches it issues), and the timed windows are
+// scaled up to the whole run. The event counters are exact.
+//
+// The profiler state is per thread, so with --threads only the router (the
+// trace, the prefetcher, and the output) is profiled.
+//
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#ifdef CACHESIM_PROFILE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROFILE_SAMPLE_PERIOD 64
+#define PROFILE_MAX_DEPTH 8
+
+enum profile_phase {
+    PROFILE_SIMULATE, // Everything not in another phase
+    PROFILE_PARSE,    // Reading and parsing trace records
+    PROFILE_LOOKUP,   // Searching a set for a line
+    PROFILE_POLICY,   // Calls through the replacement policy vtable
+    PROFILE_PREFETCH, // The prefetcher's handle_mem_access
+    PROFILE_OUTPUT,   // Per-access output
+    PROFILE_NUM_PHASES,
+};
+
+enum profile_counter {
+    PROFILE_ACCESSES,        // Demand accesses
+    PROFILE_SET_SCANS,       // Searches of a set for a line
+    PROFILE_WAYS_COMPARED,   // Lines compared during those searches
+    PROFILE_POLICY_CALLS,    // Calls through the replacement policy vtable
+    PROFILE_PREFETCH_PROBES, // Prefetches looked up in the cache
+    PROFILE_NUM_COUNTERS,
+};
+
+struct profile {
+    bool timed; // Whether the current window is timed
+    uint64_t windows, timed_windows;
+    uint64_t last_ns; // When time was last charged to a phase
+    enum profile_phase stack[PROFILE_MAX_DEPTH];
+    uint32_t depth;
+    uint64_t phase_ns[PROFILE_NUM_PHASES];
+    uint64_t finish_ns; // When the simulation finished (0 if it did not)
+    uint64_t counters[PROFILE_NUM_COUNTERS];
+};
+
+extern _Thread_local struct profile profile;
+
+// Start a new sample window (at every trace record).
+void profile_window(void);
+
+// Charge the time since the last charge to the current phase, then enter or
+// leave a phase. Only called for timed windows.
+void profile_push(enum profile_phase phase);
+void profile_pop(void);
+
+// Stop sampling after the last record. The time from here until profile_print
+// (waiting for the workers, checkpoints, and the results) is reported as is.
+void profile_finish(void);
+
+// Print the summary.
+void profile_print(FILE *out);
+
+static inline void profile_enter(enum profile_phase phase)
+{
+    if (profile.timed) profile_push(phase);
+}
+
+static inline void profile_exit(void)
+{
+    if (profile.timed) profile_pop();
+}
+
+#define PROFILE_WINDOW() profile_window()
+#define PROFILE_ENTER(phase) profile_enter(phase)
+#define PROFILE_EXIT() profile_exit()
+#define PROFILE_COUNT(counter, n) (profile.counters[counter] += (n))
+#define PROFILE_FINISH() profile_finish()
+#define PROFILE_PRINT(out) profile_print(out)
+
+#else
+
+#define PROFILE_WINDOW() ((void)0)
+#define PROFILE_ENTER(phase) ((void)0)
+#define PROFILE_EXIT() ((void)0)
+#define PROFILE_COUNT(counter, n) ((void)0)
+#define PROFILE_FINISH() ((void)0)
+#define PROFILE_PRINT(out) ((void)0)
+
+#endif
+
+#endif
@@ -12,7 +12,11 @@
 // ============================================================================
 //
 
+#include <string.h>
+
 #include "replacement_policies.h"
+#include "line_map.h"
+#include "trace.h"
 
 // For LRU
 struct lru_data
@@ -93,12 +97,42 @@ void lru_replacement_policy_cleanup(struct replacement_policy *replacement_polic
     free(lru);
 }
 
+// The LRU and LRU_PREFER_CLEAN policies share the same state (the ages), so
+// they share the checkpoint functions as well.
+int lru_replacement_policy_save(struct replacement_policy *replacement_policy, FILE *file)
+{
+    struct lru_data *lru = (struct lru_data *)replacement_policy->data;
+    for (uint32_t i = 0; i < lru->sets; i++)
+    {
+        if (fwrite(lru->ages[i], sizeof(uint32_t), lru->associativity, file) != lru->associativity)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int lru_replacement_policy_load(struct replacement_policy *replacement_policy, FILE *file)
+{
+    struct lru_data *lru = (struct lru_data *)replacement_policy->data;
+    for (uint32_t i = 0; i < lru->sets; i++)
+    {
+        if (fread(lru->ages[i], sizeof(uint32_t), lru->associativity, file) != lru->associativity)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 struct replacement_policy *lru_replacement_policy_new(uint32_t sets, uint32_t associativity)
 {
     struct replacement_policy *lru_rp = calloc(1, sizeof(struct replacement_policy));
     lru_rp->cache_access = &lru_cache_access;
     lru_rp->eviction_index = &lru_eviction_index;
     lru_rp->cleanup = &lru_replacement_policy_cleanup;
+    lru_rp->save = &lru_replacement_policy_save;
+    lru_rp->load = &lru_replacement_policy_load;
 
     // NOTE allocate any additional memory to store metadata here and assign to
     // lru_rp->data.
@@ -139,6 +173,17 @@ uint32_t rand_eviction_index(struct replacement_policy *replacement_policy,
     return rand() % cache_system->associativity;
 }
 
+int rand_replacement_policy_save(struct replacement_policy *replacement_policy, FILE *file)
+{
+    // RAND has no state to save.
+    return 0;
+}
+
+int rand_replacement_policy_load(struct replacement_policy *replacement_policy, FILE *file)
+{
+    return 0;
+}
+
 void rand_replacement_policy_cleanup(struct replacement_policy *replacement_policy)
 {
     // NOTE: cleanup any additional memory that you allocated in the
@@ -157,6 +202,8 @@ struct replacement_policy *rand_replacement_policy_new(uint32_t sets, uint32_t a
     rand_rp->cache_access = &rand_cache_access;
     rand_rp->eviction_index = &rand_eviction_index;
     rand_rp->cleanup = &rand_replacement_policy_cleanup;
+    rand_rp->save = &rand_replacement_policy_save;
+    rand_rp->load = &rand_replacement_policy_load;
 
     // NOTE: allocate any additional memory to store metadata here and assign to
     // rand_rp->data.
@@ -218,7 +265,7 @@ uint32_t lru_prefer_clean_eviction_index(struct replacement_policy *replacement_
     for (int i = 0; i < cache_system->associativity; i++)
     {
         struct cache_line *line = &cache_system->cache_lines[set_start + i];
-        if (line->status == EXCLUSIVE)
+        if (line->status == EXCLUSIVE || line->status == SHARED)
         { // Clean line
             if (lru_pc->ages[set_idx][i] < oldest_clean_age)
             {
@@ -267,6 +314,8 @@ struct replacement_policy *lru_prefer_clean_replacement_policy_new(uint32_t sets
     lru_prefer_clean_rp->cache_access = &lru_prefer_clean_cache_access;
     lru_prefer_clean_rp->eviction_index = &lru_prefer_clean_eviction_index;
     lru_prefer_clean_rp->cleanup = &lru_prefer_clean_replacement_policy_cleanup;
+    lru_prefer_clean_rp->save = &lru_replacement_policy_save;
+    lru_prefer_clean_rp->load = &lru_replacement_policy_load;
 
     // NOTE allocate any additional memory to store metadata here and assign to
     // lru_prefer_clean_rp->data.
@@ -288,3 +337,142 @@ struct replacement_policy *lru_prefer_clean_replacement_policy_new(uint32_t sets
 
     return lru_prefer_clean_rp;
 }
+
+// OPT (Belady's MIN) Replacement Policy
+// ============================================================================
+#define OPT_NEVER UINT64_MAX // Next use of a line that is never accessed again
+
+struct opt_data
+{
+    struct trace *trace;
+    uint32_t offset_bits;
+    uint32_t associativity;
+
+    // For every access in the trace, the position of the next access to the
+    // same line (or OPT_NEVER).
+    uint64_t *next_use;
+
+    // Maps each line ID to the position of its next access after the current
+    // position of the simulation.
+    struct line_map *upcoming;
+
+    // The next use of the line stored in each way of each set.
+    uint64_t *way_next_use;
+};
+
+void opt_cache_access(struct replacement_policy *replacement_policy,
+                      struct cache_system *cache_system, uint32_t set_idx, uint32_t tag)
+{
+    struct opt_data *opt = (struct opt_data *)replacement_policy->data;
+
+    // Find the way holding the accessed line.
+    struct cache_line *start = &cache_system->cache_lines[set_idx * opt->associativity];
+    for (uint32_t i = 0; i < opt->associativity; i++)
+    {
+        if (start[i].status != INVALID && start[i].tag == tag)
+        {
+            uint32_t line_id = cache_system_line_id(cache_system, set_idx, tag);
+            uint64_t *next = line_map_get(opt->upcoming, line_id);
+            opt->way_next_use[set_idx * opt->associativity + i] = next ? *next : OPT_NEVER;
+            return;
+        }
+    }
+}
+
+uint32_t opt_eviction_index(struct replacement_policy *replacement_policy,
+                            struct cache_system *cache_system, uint32_t set_idx)
+{
+    // Evict the line whose next use is furthest in the future.
+    struct opt_data *opt = (struct opt_data *)replacement_policy->data;
+    uint64_t *next_use = &opt->way_next_use[set_idx * opt->associativity];
+    uint32_t furthest_index = 0;
+    for (uint32_t i = 1; i < opt->associativity; i++)
+    {
+        if (next_use[i] > next_use[furthest_index])
+        {
+            furthest_index = i;
+        }
+    }
+    return furthest_index;
+}
+
+void opt_replacement_policy_cleanup(struct replacement_policy *replacement_policy)
+{
+    struct opt_data *opt = (struct opt_data *)replacement_policy->data;
+    free(opt->next_use);
+    free(opt->way_next_use);
+    line_map_cleanup(opt->upcoming);
+    free(opt->upcoming);
+    free(opt);
+}
+
+void opt_replacement_policy_advance(struct replacement_policy *replacement_policy,
+                                    size_t position)
+{
+    // The access at `position` is being performed, so the next access to its
+    // line is now the one after it.
+    struct opt_data *opt = (struct opt_data *)replacement_policy->data;
+    uint32_t line_id = opt->trace->records[position].address >> opt->offset_bits;
+    line_map_put(opt->upcoming, line_id, opt->next_use[position]);
+}
+
+struct replacement_policy *opt_replacement_policy_new(struct cache_system *cache_system,
+                                                      struct trace *trace)
+{
+    struct replacement_policy *opt_rp = calloc(1, sizeof(struct replacement_policy));
+    opt_rp->cache_access = &opt_cache_access;
+    opt_rp->eviction_index = &opt_eviction_index;
+    opt_rp->cleanup = &opt_replacement_policy_cleanup;
+    // OPT's state depends on the position within the in-memory trace, so it
+    // does not support checkpointing (save and load are left NULL).
+
+    struct opt_data *opt = calloc(1, sizeof(struct opt_data));
+    opt->trace = trace;
+    opt->offset_bits = cache_system->offset_bits;
+    opt->associativity = cache_system->associativity;
+    opt->way_next_use =
+        calloc(cache_system->num_sets * cache_system->associativity, sizeof(uint64_t));
+
+    // Build the next-use index with a single reverse pass over the trace. When
+    // the pass finishes, `upcoming` holds the first access of every line, which
+    // is exactly the state needed at the start of the simulation.
+    opt->next_use = malloc(trace->length * sizeof(uint64_t));
+    opt->upcoming = line_map_new(1024);
+    for (size_t i = trace->length; i-- > 0;)
+    {
+        uint32_t line_id = trace->records[i].address >> opt->offset_bits;
+        uint64_t *next = line_map_upsert(opt->upcoming, line_id, OPT_NEVER);
+        opt->next_use[i] = *next;
+        *next = i;
+    }
+
+    opt_rp->data = opt;
+    return opt_rp;
+}
+
+// Construction by name
+// ============================================================================
+struct replacement_policy *replacement_policy_new_named(const char *name,
+                                                        struct cache_system *cache_system,
+                                                        struct trace *trace)
+{
+    if (!strcmp("LRU", name))
+    {
+        return lru_replacement_policy_new(cache_system->num_sets, cache_system->associativity);
+    }
+    else if (!strcmp("RAND", name))
+    {
+        return rand_replacement_policy_new(cache_system->num_sets, cache_system->associativity);
+    }
+    else if (!strcmp("LRU_PREFER_CLEAN", name))
+    {
+        return lru_prefer_clean_replacement_policy_new(cache_system->num_sets,
+                                                       cache_system->associativity);
+    }
+    else if (!strcmp("OPT", name))
+    {
+        return opt_replacement_policy_new(cache_system, trace);
+    }
+    fprintf(stderr, "Unknown replacement policy %s", name);
+    return NULL;
+}
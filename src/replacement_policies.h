@@ -7,10 +7,12 @@
 #define REPLACEMENT_POLICIES_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
 struct cache_system;
+struct trace;
 #include "memory_system.h"
 
 // This struct describes the functionality of a replacement policy. The
@@ -60,6 +62,17 @@ struct replacement_policy
     //  * replacement_policy: the instance of replacement_policy to clean up
     void (*cleanup)(struct replacement_policy *replacement_policy);
 
+    // These functions write the state of the replacement policy to a
+    // checkpoint file and read it back. They may be NULL if the policy does
+    // not support checkpointing.
+    //
+    // Arguments:
+    //  * replacement_policy: the instance of replacement_policy
+    //  * file: the checkpoint file, positioned where the state belongs
+    // Returns: 0 on success, non-zero on failure
+    int (*save)(struct replacement_policy *replacement_policy, FILE *file);
+    int (*load)(struct replacement_policy *replacement_policy, FILE *file);
+
     // Use this pointer to store any data for the replacement policy.
     void *data;
 };
@@ -70,4 +83,23 @@ struct replacement_policy *rand_replacement_policy_new(uint32_t sets, uint32_t a
 struct replacement_policy *lru_prefer_clean_replacement_policy_new(uint32_t sets,
                                                                    uint32_t associativity);
 
+// The OPT (Belady's MIN) policy is an offline policy: it needs the whole trace
+// up front so that it can evict the line whose next use is furthest in the
+// future. The cache system is used to map addresses to line IDs.
+struct replacement_policy *opt_replacement_policy_new(struct cache_system *cache_system,
+                                                      struct trace *trace);
+
+// Tell the OPT policy that the demand access at the given position of the
+// trace is about to be performed. This must be called before each call to
+// cache_system_mem_access for that access.
+void opt_replacement_policy_advance(struct replacement_policy *replacement_policy,
+                                    size_t position);
+
+// Instantiate the replacement policy with the given name ("LRU", "RAND",
+// "LRU_PREFER_CLEAN", or "OPT") for the given cache system. The trace is only
+// used by OPT. Returns NULL if the name is unknown.
+struct replacement_policy *replacement_policy_new_named(const char *name,
+                                                        struct cache_system *cache_system,
+                                                        struct trace *trace);
+
 #endif
@@ -0,0 +1,366 @@
+//
+// This file contains the implementations for the functions defined in
+// results.h.
+//
+// The JSON and CSV writers iterate over cache_system_stat_fields, so that every
+// statistic added to struct cache_system_stats only needs to be listed once to
+// show up in both formats.
+//
+
+#include <string.h>
+
+#include "results.h"
+#include "stream_buffer.h"
+#include "timing.h"
+#include "tlb.h"
+#include "victim_cache.h"
+#include "write_buffer.h"
+
+static double ratio(uint64_t numerator, uint64_t denominator)
+{
+    return denominator == 0 ? 0.0 : (double)numerator / denominator;
+}
+
+// The whole-cache estimates. Without set sampling, these are exact.
+static void results_estimate(struct cache_system *cache_system,
+                             struct set_sampling_estimate *estimate, uint32_t *sampled_sets)
+{
+    struct cache_system_stats *stats = &cache_system->stats;
+    if (cache_system->sampling != NULL) {
+        set_sampling_estimate(cache_system->sampling, estimate);
+        *sampled_sets = cache_system->sampling->num_sampled;
+        return;
+    }
+    estimate->accesses = stats->accesses;
+    estimate->hit_ratio = ratio(stats->hits, stats->accesses);
+    estimate->hit_ratio_ci95 = 0.0;
+    estimate->misses = stats->misses;
+    estimate->misses_ci95 = 0.0;
+    *sampled_sets = cache_system->num_sets;
+}
+
+bool results_parse_format(const char *name, enum results_format *format)
+{
+    if (!strcmp(name, "text")) {
+        *format = RESULTS_TEXT;
+    } else if (!strcmp(name, "json")) {
+        *format = RESULTS_JSON;
+    } else if (!strcmp(name, "csv")) {
+        *format = RESULTS_CSV;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static void results_print_text(FILE *out, struct cache_system *cache_system,
+                               struct run_info *info)
+{
+    struct cache_system_stats *stats = &cache_system->stats;
+    fprintf(out, "\n\nStatistics\n");
+    fprintf(out, "==========\n");
+    fprintf(out, "OUTPUT ACCESSES %lu\n", (unsigned long)stats->accesses);
+    fprintf(out, "OUTPUT HITS %lu\n", (unsigned long)stats->hits);
+    fprintf(out, "OUTPUT MISSES %lu\n", (unsigned long)stats->misses);
+    fprintf(out, "OUTPUT PREFETCHES %lu\n", (unsigned long)stats->prefetches);
+    fprintf(out, "OUTPUT COMPULSORY MISSES %lu\n", (unsigned long)stats->compulsory_misses);
+    fprintf(out, "OUTPUT CONFLICT MISSES %lu\n", (unsigned long)stats->conflict_misses);
+    fprintf(out, "OUTPUT DIRTY EVICTIONS %lu\n", (unsigned long)stats->dirty_evictions);
+    fprintf(out, "OUTPUT HIT RATIO %.8f\n", (double)stats->hits / stats->accesses);
+
+    if (cache_system->sampling != NULL) {
+        struct set_sampling_estimate estimate;
+        set_sampling_estimate(cache_system->sampling, &estimate);
+        fprintf(out, "OUTPUT SAMPLED SETS %u OF %u (%u HOT)\n",
+                cache_system->sampling->num_sampled, cache_system->num_sets,
+                cache_system->sampling->num_hot);
+        fprintf(out, "OUTPUT ESTIMATED ACCESSES %.0f\n", estimate.accesses);
+        fprintf(out, "OUTPUT ESTIMATED MISSES %.0f +- %.0f\n", estimate.misses,
+                estimate.misses_ci95);
+        fprintf(out, "OUTPUT ESTIMATED HIT RATIO %.8f +- %.8f\n", estimate.hit_ratio,
+                estimate.hit_ratio_ci95);
+    }
+
+    if (info->traffic) {
+        fprintf(out, "OUTPUT BYTES READ %lu\n", (unsigned long)stats->bytes_read);
+        fprintf(out, "OUTPUT PREFETCH BYTES READ %lu\n",
+                (unsigned long)stats->prefetch_bytes_read);
+        fprintf(out, "OUTPUT BYTES WRITTEN %lu\n", (unsigned long)stats->bytes_written);
+        if (cache_system->write_buffer != NULL) {
+            fprintf(out, "OUTPUT WRITE BUFFER COALESCED %lu\n",
+                    (unsigned long)stats->write_buffer_coalesced);
+        }
+    }
+
+    if (cache_system->sectors > 1) {
+        fprintf(out, "OUTPUT SECTOR MISSES %lu\n", (unsigned long)stats->sector_misses);
+    }
+    if (cache_system->tlb != NULL) {
+        fprintf(out, "OUTPUT TLB MISSES %lu\n", (unsigned long)stats->tlb_misses);
+        fprintf(out, "OUTPUT PAGE WALKS %lu\n", (unsigned long)stats->page_walks);
+        fprintf(out, "OUTPUT PREFETCH PAGE WALKS %lu\n", (unsigned long)stats->prefetch_page_walks);
+    }
+    if (cache_system->tlb != NULL || cache_system->prefetch_pages != PREFETCH_PAGES_CROSS) {
+        fprintf(out, "OUTPUT DROPPED PREFETCHES %lu\n", (unsigned long)stats->dropped_prefetches);
+        fprintf(out, "OUTPUT USEFUL PREFETCHES %lu\n", (unsigned long)stats->useful_prefetches);
+    }
+    if (cache_system->victim_cache != NULL) {
+        fprintf(out, "OUTPUT VICTIM HITS %lu\n", (unsigned long)stats->victim_hits);
+    }
+    if (cache_system->stream_buffers != NULL) {
+        fprintf(out, "OUTPUT STREAM BUFFER HITS %lu\n", (unsigned long)stats->stream_buffer_hits);
+        fprintf(out, "OUTPUT STREAM BUFFER PREFETCHES %lu\n",
+                (unsigned long)stats->stream_buffer_prefetches);
+    }
+
+    if (cache_system->timing != NULL) {
+        timing_print_text(out, cache_system->timing);
+    }
+
+    if (info->simpoints != NULL) {
+        fprintf(out, "OUTPUT SIMPOINTS %u OF %lu INTERVALS\n", info->simpoints->count,
+                (unsigned long)info->simpoints->total_intervals);
+    }
+
+    if (info->multicore != NULL) {
+        fprintf(out, "OUTPUT COHERENCE MISSES %lu\n", (unsigned long)stats->coherence_misses);
+        multicore_print_text(out, info->multicore);
+    }
+
+    if (info->intervals != NULL) {
+        fprintf(out, "\n\nIntervals\n");
+        fprintf(out, "=========\n");
+        interval_stats_print_csv(out, info->intervals);
+    }
+}
+
+// Print a JSON string literal, escaping the characters that need it.
+static void print_json_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            fprintf(out, "\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            fprintf(out, "\\u%04x", *str);
+        } else {
+            fputc(*str, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Print a CSV field in double quotes, doubling the quotes within it.
+static void print_csv_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+    for (; *str; str++) {
+        if (*str == '"') fputc('"', out);
+        fputc(*str, out);
+    }
+    fputc('"', out);
+}
+
+static const char *write_policy_name(struct cache_system *cache_system)
+{
+    return cache_system->write_policy == WRITE_BACK ? "wb" : "wt";
+}
+
+static uint32_t write_buffer_entries(struct cache_system *cache_system)
+{
+    return cache_system->write_buffer != NULL ? cache_system->write_buffer->capacity : 0;
+}
+
+static uint32_t victim_cache_entries(struct cache_system *cache_system)
+{
+    return cache_system->victim_cache != NULL ? cache_system->victim_cache->capacity : 0;
+}
+
+static uint32_t stream_buffer_count(struct cache_system *cache_system)
+{
+    return cache_system->stream_buffers != NULL ? cache_system->stream_buffers->num_buffers : 0;
+}
+
+static const char *prefetch_pages_name(struct cache_system *cache_system)
+{
+    const char *names[] = {"cross", "stop", "tlb"};
+    return names[cache_system->prefetch_pages];
+}
+
+// The TLB geometry as `<L1 entries>:<L1 ways>:<L2 entries>:<L2 ways>`, or
+// "none".
+static const char *tlb_geometry(struct cache_system *cache_system, char *buffer, size_t size)
+{
+    if (cache_system->tlb == NULL) return "none";
+    struct tlb_config *config = &cache_system->tlb->config;
+    snprintf(buffer, size, "%u:%u:%u:%u", config->l1_entries, config->l1_associativity,
+             config->l2_entries, config->l2_associativity);
+    return buffer;
+}
+
+static uint32_t stream_buffer_depth(struct cache_system *cache_system)
+{
+    return cache_system->stream_buffers != NULL ? cache_system->stream_buffers->depth : 0;
+}
+
+static void results_print_json(FILE *out, struct cache_system *cache_system,
+                               struct run_info *info)
+{
+    struct cache_system_stats *stats = &cache_system->stats;
+    char tlb[64];
+
+    fprintf(out, "{\"config\": {\"replacement_policy\": ");
+    print_json_string(out, info->replacement_policy);
+    fprintf(out, ", \"prefetch_strategy\": ");
+    print_json_string(out, info->prefetch_strategy);
+    fprintf(out,
+            ", \"prefetch_amount\": %u, \"warmup\": %lu, \"cache_size\": %u, "
+            "\"cache_lines\": %u, \"associativity\": %u, \"line_size\": %u, \"sets\": %u, "
+            "\"write_policy\": \"%s\", \"write_allocate\": %s, \"write_buffer\": %u, "
+            "\"victim_cache\": %u, \"stream_buffers\": %u, \"stream_buffer_depth\": %u, "
+            "\"prefetch_target\": \"%s\", \"sectors\": %u, \"page_size\": %u, "
+            "\"prefetch_pages\": \"%s\", \"tlb\": \"%s\", \"index\": \"%s\"}",
+            info->prefetch_amount, (unsigned long)info->warmup, info->cache_size, info->cache_lines,
+            cache_system->associativity, cache_system->line_size, cache_system->num_sets,
+            write_policy_name(cache_system), cache_system->write_allocate ? "true" : "false",
+            write_buffer_entries(cache_system), victim_cache_entries(cache_system),
+            stream_buffer_count(cache_system), stream_buffer_depth(cache_system),
+            cache_system->prefetch_to_stream_buffers ? "stream" : "cache", cache_system->sectors,
+            1u << cache_system->page_bits, prefetch_pages_name(cache_system),
+            tlb_geometry(cache_system, tlb, sizeof(tlb)),
+            cache_system_index_function_name(cache_system->index_function));
+
+    fprintf(out, ", \"trace\": {\"path\": ");
+    print_json_string(out, info->trace_path);
+    fprintf(out, ", \"records\": %lu, \"hash\": \"%016lx\"}", (unsigned long)info->trace_records,
+            (unsigned long)info->trace_hash);
+
+    fprintf(out, ", \"stats\": {");
+    for (size_t i = 0; i < cache_system_num_stat_fields; i++) {
+        fprintf(out, "%s\"%s\": %lu", i ? ", " : "", cache_system_stat_fields[i].name,
+                (unsigned long)cache_system_stat(stats, &cache_system_stat_fields[i]));
+    }
+    fprintf(out, ", \"hit_ratio\": %.8f, \"miss_ratio\": %.8f, \"prefetches_per_access\": %.8f}",
+            ratio(stats->hits, stats->accesses), ratio(stats->misses, stats->accesses),
+            ratio(stats->prefetches, stats->accesses));
+
+    struct set_sampling_estimate estimate;
+    uint32_t sampled_sets;
+    results_estimate(cache_system, &estimate, &sampled_sets);
+    fprintf(out,
+            ", \"sampling\": {\"sampled_sets\": %u, \"hot_sets\": %u, "
+            "\"estimated_accesses\": %.0f, \"estimated_misses\": %.0f, "
+            "\"estimated_misses_ci95\": %.1f, \"estimated_hit_ratio\": %.8f, "
+            "\"hit_ratio_ci95\": %.8f}",
+            sampled_sets, cache_system->sampling ? cache_system->sampling->num_hot : 0,
+            estimate.accesses, estimate.misses, estimate.misses_ci95, estimate.hit_ratio,
+            estimate.hit_ratio_ci95);
+
+    double records_per_second =
+        info->wall_seconds > 0 ? info->trace_records / info->wall_seconds : 0.0;
+    double ns_per_access =
+        info->trace_records > 0 ? info->wall_seconds * 1e9 / info->trace_records : 0.0;
+    fprintf(out,
+            ", \"simulator\": {\"wall_seconds\": %.6f, \"records_per_second\": %.1f, "
+            "\"ns_per_access\": %.3f, \"peak_rss_kb\": %ld, \"threads\": %u}",
+            info->wall_seconds, records_per_second, ns_per_access, info->peak_rss_kb,
+            info->threads);
+
+    if (cache_system->timing != NULL) {
+        fprintf(out, ", ");
+        timing_print_json(out, cache_system->timing);
+    }
+    if (info->simpoints != NULL) {
+        fprintf(out, ", \"simpoints\": {\"count\": %u, \"interval\": %lu, \"intervals\": %lu}",
+                info->simpoints->count, (unsigned long)info->simpoints->interval,
+                (unsigned long)info->simpoints->total_intervals);
+    }
+    if (info->multicore != NULL) {
+        fprintf(out, ", ");
+        multicore_print_json(out, info->multicore);
+    }
+    if (info->intervals != NULL) {
+        fprintf(out, ", \"intervals\": ");
+        interval_stats_print_json(out, info->intervals);
+    }
+    fprintf(out, "}\n");
+}
+
+static void results_print_csv(FILE *out, struct cache_system *cache_system,
+                              struct run_info *info)
+{
+    struct cache_system_stats *stats = &cache_system->stats;
+    char tlb[64];
+
+    // Header row
+    if (info->csv_header) {
+        fprintf(out, "replacement_policy,prefetch_strategy,prefetch_amount,warmup,cache_size,"
+                     "cache_lines,associativity,line_size,sets,write_policy,write_allocate,"
+                     "write_buffer,victim_cache,stream_buffers,stream_buffer_depth,"
+                     "prefetch_target,sectors,page_size,prefetch_pages,tlb,index,trace_path,"
+                     "trace_records,trace_hash");
+        for (size_t i = 0; i < cache_system_num_stat_fields; i++) {
+            fprintf(out, ",%s", cache_system_stat_fields[i].name);
+        }
+        fprintf(out, ",hit_ratio,miss_ratio,prefetches_per_access,sampled_sets,hot_sets,"
+                     "estimated_accesses,estimated_misses,estimated_misses_ci95,"
+                     "estimated_hit_ratio,hit_ratio_ci95,wall_seconds,records_per_second,"
+                     "ns_per_access,peak_rss_kb,cycles,amat,stall_cycles,mshr_occupancy\n");
+    }
+
+    // Data row
+    print_csv_string(out, info->replacement_policy);
+    fprintf(out, ",");
+    print_csv_string(out, info->prefetch_strategy);
+    fprintf(out, ",%u,%lu,%u,%u,%u,%u,%u,%s,%d,%u,%u,%u,%u,%s,%u,%u,%s,%s,%s,",
+            info->prefetch_amount,
+            (unsigned long)info->warmup, info->cache_size, info->cache_lines,
+            cache_system->associativity, cache_system->line_size, cache_system->num_sets,
+            write_policy_name(cache_system), cache_system->write_allocate,
+            write_buffer_entries(cache_system), victim_cache_entries(cache_system),
+            stream_buffer_count(cache_system), stream_buffer_depth(cache_system),
+            cache_system->prefetch_to_stream_buffers ? "stream" : "cache", cache_system->sectors,
+            1u << cache_system->page_bits, prefetch_pages_name(cache_system),
+            tlb_geometry(cache_system, tlb, sizeof(tlb)),
+            cache_system_index_function_name(cache_system->index_function));
+    print_csv_string(out, info->trace_path);
+    fprintf(out, ",%lu,%016lx", (unsigned long)info->trace_records,
+            (unsigned long)info->trace_hash);
+    for (size_t i = 0; i < cache_system_num_stat_fields; i++) {
+        fprintf(out, ",%lu", (unsigned long)cache_system_stat(stats, &cache_system_stat_fields[i]));
+    }
+    double records_per_second =
+        info->wall_seconds > 0 ? info->trace_records / info->wall_seconds : 0.0;
+    double ns_per_access =
+        info->trace_records > 0 ? info->wall_seconds * 1e9 / info->trace_records : 0.0;
+    struct set_sampling_estimate estimate;
+    uint32_t sampled_sets;
+    results_estimate(cache_system, &estimate, &sampled_sets);
+    fprintf(out, ",%.8f,%.8f,%.8f,%u,%u,%.0f,%.0f,%.1f,%.8f,%.8f,%.6f,%.1f,%.3f,%ld",
+            ratio(stats->hits, stats->accesses), ratio(stats->misses, stats->accesses),
+            ratio(stats->prefetches, stats->accesses), sampled_sets,
+            cache_system->sampling ? cache_system->sampling->num_hot : 0, estimate.accesses,
+            estimate.misses, estimate.misses_ci95, estimate.hit_ratio, estimate.hit_ratio_ci95,
+            info->wall_seconds, records_per_second, ns_per_access, info->peak_rss_kb);
+    struct timing_model *timing = cache_system->timing;
+    fprintf(out, ",%lu,%.4f,%lu,%.4f\n", (unsigned long)(timing ? timing_cycles(timing) : 0),
+            timing ? timing_amat(timing) : 0.0,
+            (unsigned long)(timing ? timing->stats.stall_cycles : 0),
+            timing ? timing_mshr_occupancy(timing) : 0.0);
+}
+
+void results_print(FILE *out, enum results_format format, struct cache_system *cache_system,
+                   struct run_info *info)
+{
+    switch (format) {
+    case RESULTS_TEXT:
+        results_print_text(out, cache_system, info);
+        break;
+    case RESULTS_JSON:
+        results_print_json(out, cache_system, info);
+        break;
+    case RESULTS_CSV:
+        results_print_csv(out, cache_system, info);
+        break;
+    }
+}
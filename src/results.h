@@ -0,0 +1,74 @@
+//
+// This file defines the function signatures for printing the results of a
+// simulation run, either as the human-readable `OUTPUT ...` lines or in a
+// machine-readable format (one JSON object or one CSV row per run).
+//
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "coherence.h"
+#include "interval_stats.h"
+#include "memory_system.h"
+#include "simpoint.h"
+
+enum results_format {
+    RESULTS_TEXT,
+    RESULTS_JSON,
+    RESULTS_CSV,
+};
+
+// Everything about a run that is not part of the cache system statistics: the
+// configuration, the identity of the trace, and the performance of the
+// simulator itself.
+struct run_info {
+    // Configuration
+    const char *replacement_policy;
+    const char *prefetch_strategy;
+    uint32_t prefetch_amount;
+    uint64_t warmup; // Number of records simulated before statistics were counted
+    uint32_t cache_size;
+    uint32_t cache_lines;
+
+    // Trace identity
+    const char *trace_path;
+    uint64_t trace_records;
+    uint64_t trace_hash;
+
+    // Simulator performance
+    double wall_seconds;
+    long peak_rss_kb;
+    uint32_t threads; // Number of threads the sets were partitioned across
+
+    // Whether to print the memory traffic statistics in the text output (they
+    // are always part of the structured formats).
+    bool traffic;
+
+    // Whether to print the CSV header row before the data row, so that the
+    // rows of several runs can be appended to one file.
+    bool csv_header;
+
+    // The interval time series to include in the output (NULL if none).
+    struct interval_stats *intervals;
+
+    // The multi-core system whose per-core statistics to include (NULL if none).
+    struct multicore_system *multicore;
+
+    // The simpoints the statistics were estimated from (NULL if the whole
+    // trace was simulated).
+    struct simpoints *simpoints;
+};
+
+// Parse a format name ("text", "json", or "csv"). Returns false if the name is
+// not recognized.
+bool results_parse_format(const char *name, enum results_format *format);
+
+// Print the results of a run in the given format.
+void results_print(FILE *out, enum results_format format, struct cache_system *cache_system,
+                   struct run_info *info);
+
+#endif
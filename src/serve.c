@@ -0,0 +1,586 @@
+//
+// This file contains the implementations for the functions defined in serve.h.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memory_system.h"
+#include "options.h"
+#include "prefetchers.h"
+#include "replacement_policies.h"
+#include "results.h"
+#include "serve.h"
+#include "trace.h"
+
+#define SERVE_DEFAULT_BATCH 4096
+
+struct serve_config {
+    const char *spec;
+    char replacement_policy[32];
+    char prefetch_strategy[32];
+    uint32_t prefetch_amount, cache_size, cache_lines, associativity;
+    struct cache_system *cache_system;
+};
+
+struct server {
+    struct serve_config configs[SERVE_MAX_CONFIGS];
+    uint32_t num_configs;
+    enum results_format format;
+    const char *path;
+
+    // The stream received since the start (or the last reset), identified
+    // like a trace file.
+    uint64_t records;
+    uint64_t hash;
+
+    double start_time;
+    uint64_t snapshots;
+    bool failed; // Whether the simulation itself failed
+    struct serve_access *batch;
+};
+
+// What to do after the messages of a producer were handled.
+enum serve_status {
+    SERVE_NEXT_PRODUCER, // The producer disconnected (or was dropped after an error)
+    SERVE_STOP,          // The server was shut down (or the simulation failed)
+};
+
+static volatile sig_atomic_t serve_snapshot_requested = 0;
+
+static void serve_request_snapshot(int signal)
+{
+    serve_snapshot_requested = 1;
+}
+
+static double serve_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Parse a configuration and create its cache system. Returns 0 on success.
+static int serve_config_init(struct serve_config *config, const char *spec)
+{
+    config->spec = spec;
+    if (sscanf(spec, "%31[^:]:%u:%u:%u:%31[^:]:%u", config->replacement_policy,
+               &config->cache_size, &config->cache_lines, &config->associativity,
+               config->prefetch_strategy, &config->prefetch_amount) != 6 ||
+        config->cache_lines == 0 || config->associativity == 0) {
+        fprintf(stderr, "--config must be <policy>:<cache_size>:<cache_lines>:<associativity>:"
+                        "<prefetch>:<amount>\n");
+        return 1;
+    }
+    uint32_t line_size = config->cache_size / config->cache_lines;
+    uint32_t sets = config->cache_lines / config->associativity;
+    if (line_size == 0 || (line_size & (line_size - 1)) || sets == 0 || (sets & (sets - 1))) {
+        fprintf(stderr, "Configuration %s must have a power-of-two line size and number of "
+                        "sets\n",
+                spec);
+        return 1;
+    }
+    if (!strcmp("OPT", config->replacement_policy)) {
+        fprintf(stderr, "OPT needs the whole trace up front, so it cannot be served\n");
+        return 1;
+    }
+
+    struct cache_system *cache_system = cache_system_new(line_size, sets, config->associativity);
+    cache_system->verbose = false;
+    cache_system->replacement_policy =
+        replacement_policy_new_named(config->replacement_policy, cache_system, NULL);
+    cache_system->prefetcher =
+        prefetcher_new_named(config->prefetch_strategy, config->prefetch_amount);
+    config->cache_system = cache_system;
+    if (cache_system->replacement_policy == NULL || cache_system->prefetcher == NULL) {
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    return 0;
+}
+
+static void serve_config_cleanup(struct serve_config *config)
+{
+    struct cache_system *cache_system = config->cache_system;
+    if (cache_system == NULL) return;
+    if (cache_system->prefetcher != NULL) {
+        cache_system->prefetcher->cleanup(cache_system->prefetcher);
+        free(cache_system->prefetcher);
+    }
+    if (cache_system->replacement_policy != NULL) {
+        cache_system_cleanup(cache_system);
+    }
+    free(cache_system);
+}
+
+// Print the results of every configuration so far.
+static void serve_snapshot(struct server *server, FILE *out)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    server->snapshots++;
+    for (uint32_t i = 0; i < server->num_configs; i++) {
+        struct serve_config *config = &server->configs[i];
+        struct run_info info = {
+            .replacement_policy = config->replacement_policy,
+            .prefetch_strategy = config->prefetch_strategy,
+            .prefetch_amount = config->prefetch_amount,
+            .warmup = 0,
+            .cache_size = config->cache_size,
+            .cache_lines = config->cache_lines,
+            .trace_path = server->path,
+            .trace_records = server->records,
+            .trace_hash = server->hash,
+            .wall_seconds = serve_seconds() - server->start_time,
+            .peak_rss_kb = usage.ru_maxrss,
+            .threads = 1,
+            .csv_header = i == 0,
+        };
+        if (server->format == RESULTS_TEXT) {
+            fprintf(out, "\nSNAPSHOT %lu CONFIG %u %s", (unsigned long)server->snapshots, i,
+                    config->spec);
+        }
+        results_print(out, server->format, config->cache_system, &info);
+    }
+    fflush(out);
+}
+
+// Print a snapshot if SIGUSR1 asked for one.
+static void serve_check_signal(struct server *server)
+{
+    if (server != NULL && serve_snapshot_requested) {
+        serve_snapshot_requested = 0;
+        serve_snapshot(server, stdout);
+    }
+}
+
+// Read exactly `size` bytes. Returns 1 once they are read, 0 if the stream
+// ended before the first of them, and -1 on an error or a truncated message.
+// Snapshots requested while waiting are printed.
+static int serve_read(struct server *server, int fd, void *buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, (char *)buffer + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            serve_check_signal(server);
+            continue;
+        }
+        if (n < 0) {
+            perror("read");
+            return -1;
+        }
+        if (n == 0) {
+            if (done == 0) return 0;
+            fprintf(stderr, "The stream ended in the middle of a message\n");
+            return -1;
+        }
+        done += n;
+    }
+    return 1;
+}
+
+// Write all of the bytes. Returns 0 on success.
+static int serve_write(int fd, const void *buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, (const char *)buffer + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("write");
+            return 1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+// Answer a SERVE_STATS message on the socket.
+static int serve_reply_snapshot(struct server *server, int fd)
+{
+    char *text = NULL;
+    size_t length = 0;
+    FILE *out = open_memstream(&text, &length);
+    serve_snapshot(server, out);
+    fclose(out);
+    struct serve_message reply = {.type = SERVE_STATS, .count = length};
+    int result = serve_write(fd, &reply, sizeof(reply)) || serve_write(fd, text, length);
+    free(text);
+    return result;
+}
+
+// Simulate a batch on every configuration. Returns -1 if the batch is
+// malformed, and 0 otherwise. If the simulation fails, `failed` is set.
+static int serve_simulate(struct server *server, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (server->batch[i].rw != 'R' && server->batch[i].rw != 'W') {
+            fprintf(stderr, "Access %u of the batch is neither a read nor a write\n", i);
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        struct serve_access *access = &server->batch[i];
+        struct trace_record record = {
+            .address = access->address,
+            .rw = access->rw,
+            .core = access->core,
+        };
+        server->hash = trace_hash_record(server->hash, &record);
+        server->records++;
+        for (uint32_t c = 0; c < server->num_configs; c++) {
+            if (cache_system_mem_access(server->configs[c].cache_system, record.address,
+                                        record.rw, false) != 0) {
+                server->failed = true;
+                return 0;
+            }
+        }
+    }
+    return 0;
+}
+
+// Handle the messages of one producer until it disconnects. A producer that
+// breaks the protocol is dropped. Snapshots are answered on the stream if
+// `reply` is set, and printed to stdout otherwise.
+static enum serve_status serve_producer(struct server *server, int fd, bool reply)
+{
+    struct serve_message message;
+    int status;
+    while ((status = serve_read(server, fd, &message, sizeof(message))) == 1) {
+        switch (message.type) {
+        case SERVE_BATCH:
+            if (message.count > SERVE_MAX_BATCH) {
+                fprintf(stderr, "Batches can have at most %d accesses\n", SERVE_MAX_BATCH);
+                return SERVE_NEXT_PRODUCER;
+            }
+            if (serve_read(server, fd, server->batch,
+                           message.count * sizeof(struct serve_access)) != 1 ||
+                serve_simulate(server, message.count) != 0) {
+                return SERVE_NEXT_PRODUCER;
+            }
+            if (server->failed) return SERVE_STOP;
+            break;
+        case SERVE_STATS:
+            if (!reply) {
+                serve_snapshot(server, stdout);
+            } else if (serve_reply_snapshot(server, fd) != 0) {
+                return SERVE_NEXT_PRODUCER;
+            }
+            break;
+        case SERVE_RESET:
+            for (uint32_t i = 0; i < server->num_configs; i++) {
+                memset(&server->configs[i].cache_system->stats, 0,
+                       sizeof(struct cache_system_stats));
+            }
+            server->records = 0;
+            server->hash = TRACE_HASH_EMPTY;
+            break;
+        case SERVE_SHUTDOWN:
+            return SERVE_STOP;
+        default:
+            fprintf(stderr, "Unknown message type %u\n", message.type);
+            return SERVE_NEXT_PRODUCER;
+        }
+        serve_check_signal(server);
+    }
+    return SERVE_NEXT_PRODUCER;
+}
+
+// Fill `address` with the path of a Unix domain socket. Returns 0 on success.
+static int serve_socket_address(const char *path, struct sockaddr_un *address)
+{
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "The socket path %s is too long\n", path);
+        return 1;
+    }
+    strcpy(address->sun_path, path);
+    return 0;
+}
+
+// Accept producers on a Unix domain socket until the server is shut down.
+static int serve_socket(struct server *server, const char *path)
+{
+    struct sockaddr_un address;
+    if (serve_socket_address(path, &address) != 0) return 1;
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    // Replace a socket left behind by a server that is gone, but not one that
+    // is still accepting connections.
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool alive = connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+        close(probe);
+        if (alive) {
+            fprintf(stderr, "Another server is listening on %s\n", path);
+            close(listener);
+            return 1;
+        }
+        unlink(path);
+    }
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, 1) != 0) {
+        perror(path);
+        close(listener);
+        return 1;
+    }
+
+    enum serve_status status = SERVE_NEXT_PRODUCER;
+    while (status != SERVE_STOP) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0 && errno == EINTR) {
+            serve_check_signal(server);
+            continue;
+        }
+        if (fd < 0) {
+            perror("accept");
+            server->failed = true;
+            break;
+        }
+        status = serve_producer(server, fd, true);
+        close(fd);
+    }
+    close(listener);
+    unlink(path);
+    return 0;
+}
+
+// Read producers from a named pipe (created if it does not exist) until the
+// server is shut down.
+static int serve_fifo(struct server *server, const char *path)
+{
+    struct stat st;
+    bool created = false;
+    if (stat(path, &st) != 0) {
+        if (mkfifo(path, 0600) != 0) {
+            perror(path);
+            return 1;
+        }
+        created = true;
+    } else if (!S_ISFIFO(st.st_mode)) {
+        fprintf(stderr, "%s is not a named pipe\n", path);
+        return 1;
+    }
+
+    enum serve_status status = SERVE_NEXT_PRODUCER;
+    while (status != SERVE_STOP) {
+        // Opening the pipe waits for the next producer.
+        int fd = open(path, O_RDONLY);
+        if (fd < 0 && errno == EINTR) {
+            serve_check_signal(server);
+            continue;
+        }
+        if (fd < 0) {
+            perror(path);
+            server->failed = true;
+            break;
+        }
+        status = serve_producer(server, fd, false);
+        close(fd);
+    }
+    if (created) unlink(path);
+    return 0;
+}
+
+int serve_main(int argc, char **argv)
+{
+    struct server *server = calloc(1, sizeof(struct server));
+    server->format = RESULTS_TEXT;
+    server->hash = TRACE_HASH_EMPTY;
+    server->start_time = serve_seconds();
+    const char *socket_path = NULL;
+    const char *fifo_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value;
+        if ((value = option_value(argv[i], "socket"))) {
+            socket_path = value;
+        } else if ((value = option_value(argv[i], "fifo"))) {
+            fifo_path = value;
+        } else if ((value = option_value(argv[i], "format"))) {
+            if (!results_parse_format(value, &server->format)) {
+                fprintf(stderr, "Unknown output format %s\n", value);
+                return 1;
+            }
+        } else if ((value = option_value(argv[i], "config"))) {
+            if (server->num_configs == SERVE_MAX_CONFIGS) {
+                fprintf(stderr, "At most %d configurations can be served\n", SERVE_MAX_CONFIGS);
+                return 1;
+            }
+            if (serve_config_init(&server->configs[server->num_configs++], value) != 0) {
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if ((socket_path == NULL) == (fifo_path == NULL) || server->num_configs == 0) {
+        fprintf(stderr, "Usage: cachesim serve (--socket=<path> | --fifo=<path>) "
+                        "--config=<policy>:<cache_size>:<cache_lines>:<associativity>:"
+                        "<prefetch>:<amount> [--config=...] [--format=text|json|csv]\n");
+        return 1;
+    }
+
+    // SIGUSR1 interrupts the blocking reads so that the snapshot is printed
+    // right away. A producer that disconnects before its snapshot is sent
+    // must not kill the server.
+    struct sigaction action = {.sa_handler = serve_request_snapshot};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    server->batch = malloc(SERVE_MAX_BATCH * sizeof(struct serve_access));
+    server->path = socket_path != NULL ? socket_path : fifo_path;
+    int result = socket_path != NULL ? serve_socket(server, socket_path)
+                                     : serve_fifo(server, fifo_path);
+    if (result == 0) {
+        serve_snapshot(server, stdout);
+        result = server->failed;
+    }
+
+    for (uint32_t i = 0; i < server->num_configs; i++) {
+        serve_config_cleanup(&server->configs[i]);
+    }
+    free(server->batch);
+    free(server);
+    return result;
+}
+
+struct feed_options {
+    bool socket; // Whether the server is on a socket (rather than a named pipe)
+    uint32_t batch_size;
+    bool reset, stats, shutdown;
+};
+
+// Send the trace and the requests to the server. Returns 0 on success.
+static int feed_send(int fd, struct feed_options *options, struct trace_reader *reader,
+                     struct serve_access *batch)
+{
+    struct serve_message message = {.type = SERVE_RESET};
+    if (options->reset && serve_write(fd, &message, sizeof(message)) != 0) return 1;
+
+    // Send the trace. The writes block whenever the server falls behind.
+    struct trace_record record;
+    bool more = true;
+    while (more) {
+        message = (struct serve_message){.type = SERVE_BATCH, .count = 0};
+        while (message.count < options->batch_size &&
+               (more = trace_reader_next(reader, &record))) {
+            batch[message.count++] = (struct serve_access){
+                .address = record.address,
+                .core = record.core,
+                .rw = record.rw,
+            };
+        }
+        if (message.count > 0 &&
+            (serve_write(fd, &message, sizeof(message)) != 0 ||
+             serve_write(fd, batch, message.count * sizeof(struct serve_access)) != 0)) {
+            return 1;
+        }
+    }
+    if (reader->malformed) return 1;
+
+    if (options->stats) {
+        message = (struct serve_message){.type = SERVE_STATS};
+        if (serve_write(fd, &message, sizeof(message)) != 0) return 1;
+        if (options->socket) {
+            struct serve_message reply;
+            if (serve_read(NULL, fd, &reply, sizeof(reply)) != 1 || reply.type != SERVE_STATS) {
+                fprintf(stderr, "The server did not send a snapshot\n");
+                return 1;
+            }
+            char *text = malloc(reply.count);
+            int result = serve_read(NULL, fd, text, reply.count) != 1;
+            if (result == 0) fwrite(text, 1, reply.count, stdout);
+            free(text);
+            if (result != 0) return 1;
+        }
+    }
+    message = (struct serve_message){.type = SERVE_SHUTDOWN};
+    if (options->shutdown && serve_write(fd, &message, sizeof(message)) != 0) return 1;
+    return 0;
+}
+
+int feed_main(int argc, char **argv)
+{
+    const char *socket_path = NULL;
+    const char *fifo_path = NULL;
+    struct feed_options options = {.batch_size = SERVE_DEFAULT_BATCH};
+    for (int i = 1; i < argc; i++) {
+        const char *value;
+        if ((value = option_value(argv[i], "socket"))) {
+            socket_path = value;
+        } else if ((value = option_value(argv[i], "fifo"))) {
+            fifo_path = value;
+        } else if ((value = option_value(argv[i], "batch"))) {
+            options.batch_size = strtoul(value, NULL, 10);
+        } else if (!strcmp(argv[i], "--reset")) {
+            options.reset = true;
+        } else if (!strcmp(argv[i], "--stats")) {
+            options.stats = true;
+        } else if (!strcmp(argv[i], "--shutdown")) {
+            options.shutdown = true;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if ((socket_path == NULL) == (fifo_path == NULL) || options.batch_size == 0 ||
+        options.batch_size > SERVE_MAX_BATCH) {
+        fprintf(stderr, "Usage: cachesim feed (--socket=<path> | --fifo=<path>) [--batch=N] "
+                        "[--reset] [--stats] [--shutdown] < <trace_file>\n"
+                        "Batches can have at most %d accesses\n",
+                SERVE_MAX_BATCH);
+        return 1;
+    }
+    options.socket = socket_path != NULL;
+
+    // Connect to the server. Opening a named pipe waits for the server to
+    // open it too.
+    int fd;
+    if (socket_path != NULL) {
+        struct sockaddr_un address;
+        if (serve_socket_address(socket_path, &address) != 0) return 1;
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            perror(socket_path);
+            return 1;
+        }
+    } else {
+        fd = open(fifo_path, O_WRONLY);
+        if (fd < 0) {
+            perror(fifo_path);
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    struct serve_access *batch = calloc(options.batch_size, sizeof(struct serve_access));
+    struct trace_reader *reader = malloc(sizeof(struct trace_reader));
+    trace_reader_init_file(reader, stdin);
+    int result = feed_send(fd, &options, reader, batch);
+    close(fd);
+    free(reader);
+    free(batch);
+    return result;
+}
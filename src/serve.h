@@ -0,0 +1,76 @@
+//
+// This file defines the `serve` and `feed` subcommands, which simulate a
+// stream of accesses online instead of a trace file.
+//
+// The server keeps one or more cache systems alive and simulates every access
+// it receives on all of them:
+//
+//      cachesim serve (--socket=<path> | --fifo=<path>) --config=<config>
+//                     [--config=<config> ...] [--format=text|json|csv]
+//
+// where every <config> is
+// <policy>:<cache_size>:<cache_lines>:<associativity>:<prefetch>:<amount>, as
+// in the arguments of a regular run (OPT, which needs the whole trace up
+// front, is not supported).
+//
+// It listens on a Unix domain socket, or reads from a named pipe. Producers
+// connect one at a time, and the cache systems (and their statistics) live on
+// from one producer to the next. When the server is shut down, it prints a
+// final snapshot to stdout.
+//
+// A producer sends messages, each made of a struct serve_message header and,
+// for a batch, `count` struct serve_access records. The server reads the next
+// batch only once it has simulated the previous one, so a producer that gets
+// ahead of it blocks on the full pipe or socket buffer.
+//
+// A snapshot of the statistics so far (the results of every configuration, in
+// the given format, with a single header row for CSV) can be requested with a
+// SERVE_STATS message, which is answered on the socket (or printed to stdout
+// for a named pipe), or by sending SIGUSR1 to the server, which prints it to
+// stdout.
+//
+// `feed` is a producer that streams a trace file (from stdin) to a server:
+//
+//      cachesim feed (--socket=<path> | --fifo=<path>) [--batch=N] [--reset]
+//                    [--stats] [--shutdown] < <trace_file>
+//
+// With --reset, the statistics are cleared before the trace is sent. With
+// --stats, a snapshot is requested after it (and printed to stdout when
+// using a socket). With --shutdown, the server is stopped at the end.
+//
+// The messages are in the byte order of the host, since both ends run on it.
+//
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdint.h>
+
+#define SERVE_MAX_BATCH 65536
+#define SERVE_MAX_CONFIGS 16
+
+enum serve_message_type {
+    SERVE_BATCH = 1,    // `count` struct serve_access follow
+    SERVE_STATS = 2,    // Request a snapshot. Answered on a socket by a SERVE_STATS
+                        // message with the `count` bytes of the snapshot.
+    SERVE_RESET = 3,    // Zero the statistics (the contents of the caches are kept)
+    SERVE_SHUTDOWN = 4, // Stop the server
+};
+
+struct serve_message {
+    uint32_t type;
+    uint32_t count;
+};
+
+struct serve_access {
+    uint32_t address;
+    uint16_t core;
+    char rw; // 'R' or 'W'
+    uint8_t reserved;
+};
+
+// Run the subcommands. argv[0] is "serve" or "feed". Returns the exit status.
+int serve_main(int argc, char **argv);
+int feed_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,155 @@
+//
+// This file contains the implementations for the functions defined in
+// set_sampling.h.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "set_sampling.h"
+
+#define Z_95 1.96 // Two-sided 95% quantile of the normal distribution
+
+// A 32-bit integer hash (the MurmurHash3 finalizer). Hashing the set index
+// keeps the sampled sets from lining up with power-of-two strides.
+static uint32_t set_hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x;
+}
+
+// Two-sided 95% quantile of Student's t distribution with `df` degrees of
+// freedom (the Cornish-Fisher expansion around the normal quantile).
+static double t_95(double df)
+{
+    double z = Z_95, z3 = z * z * z, z5 = z3 * z * z;
+    return z + (z3 + z) / (4 * df) + (5 * z5 + 16 * z3 + 3 * z) / (96 * df * df);
+}
+
+struct set_sampling *set_sampling_new(uint32_t num_sets, uint32_t rate, uint32_t seed)
+{
+    struct set_sampling *sampling = calloc(1, sizeof(struct set_sampling));
+    sampling->rate = rate;
+    sampling->seed = seed;
+    sampling->num_sets = num_sets;
+    sampling->num_sampled = num_sets;
+    sampling->sampled = malloc(num_sets * sizeof(uint8_t));
+    memset(sampling->sampled, SET_SAMPLING_RANDOM, num_sets * sizeof(uint8_t));
+    sampling->set_accesses = calloc(num_sets, sizeof(uint64_t));
+    sampling->set_hits = calloc(num_sets, sizeof(uint64_t));
+    sampling->pilot = true;
+    sampling->pilot_end = (uint64_t)num_sets * SET_SAMPLING_PILOT_PER_SET;
+    return sampling;
+}
+
+void set_sampling_cleanup(struct set_sampling *sampling)
+{
+    free(sampling->sampled);
+    free(sampling->set_accesses);
+    free(sampling->set_hits);
+}
+
+struct set_count {
+    uint64_t accesses;
+    uint32_t set_idx;
+};
+
+// Orders sets by decreasing number of accesses.
+static int compare_set_counts(const void *a, const void *b)
+{
+    uint64_t x = ((const struct set_count *)a)->accesses;
+    uint64_t y = ((const struct set_count *)b)->accesses;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+void set_sampling_select(struct set_sampling *sampling)
+{
+    uint32_t num_sets = sampling->num_sets;
+    uint32_t budget = num_sets / sampling->rate;
+    if (budget < SET_SAMPLING_MIN_SETS) budget = SET_SAMPLING_MIN_SETS;
+    sampling->pilot = false;
+    if (budget >= num_sets) return; // Every set stays simulated
+
+    // The hottest sets of the pilot, up to half of the budget.
+    struct set_count *order = malloc(num_sets * sizeof(struct set_count));
+    for (uint32_t i = 0; i < num_sets; i++) {
+        order[i] = (struct set_count){sampling->set_accesses[i], i};
+    }
+    qsort(order, num_sets, sizeof(struct set_count), compare_set_counts);
+    double mean = (double)sampling->accesses / num_sets;
+    memset(sampling->sampled, SET_SAMPLING_SKIPPED, num_sets * sizeof(uint8_t));
+    uint32_t num_hot = 0;
+    while (num_hot < budget / 2 && order[num_hot].accesses >= SET_SAMPLING_HOT_FACTOR * mean) {
+        sampling->sampled[order[num_hot++].set_idx] = SET_SAMPLING_HOT;
+    }
+    free(order);
+
+    // A random sample of the other sets fills the rest of the budget.
+    double fraction = (double)(budget - num_hot) / (num_sets - num_hot);
+    uint32_t salt = set_hash(sampling->seed ^ 0x9e3779b9);
+    uint32_t num_sampled = num_hot;
+    for (uint32_t i = 0; i < num_sets; i++) {
+        if (sampling->sampled[i] == SET_SAMPLING_SKIPPED &&
+            set_hash(i ^ salt) < fraction * 4294967296.0) {
+            sampling->sampled[i] = SET_SAMPLING_RANDOM;
+            num_sampled++;
+        }
+    }
+    sampling->num_hot = num_hot;
+    sampling->num_sampled = num_sampled;
+}
+
+void set_sampling_reset(struct set_sampling *sampling)
+{
+    memset(sampling->set_accesses, 0, sampling->num_sets * sizeof(uint64_t));
+    memset(sampling->set_hits, 0, sampling->num_sets * sizeof(uint64_t));
+}
+
+void set_sampling_estimate(struct set_sampling *sampling, struct set_sampling_estimate *estimate)
+{
+    // Every access, the hits of the hot sets, and the accesses of the others.
+    double accesses = 0, hot_hits = 0, rest_accesses = 0;
+    // The sums over the random sample.
+    double n = 0, sample_accesses = 0, sample_hits = 0;
+    double N = 0;
+    for (uint32_t i = 0; i < sampling->num_sets; i++) {
+        accesses += sampling->set_accesses[i];
+        if (sampling->sampled[i] == SET_SAMPLING_HOT) {
+            hot_hits += sampling->set_hits[i];
+            continue;
+        }
+        N++;
+        rest_accesses += sampling->set_accesses[i];
+        if (sampling->sampled[i] == SET_SAMPLING_RANDOM) {
+            n++;
+            sample_accesses += sampling->set_accesses[i];
+            sample_hits += sampling->set_hits[i];
+        }
+    }
+    double r = sample_accesses > 0 ? sample_hits / sample_accesses : 0.0;
+
+    // Sum of squares of the ratio residuals.
+    double residual_ss = 0;
+    for (uint32_t i = 0; i < sampling->num_sets; i++) {
+        if (sampling->sampled[i] != SET_SAMPLING_RANDOM) continue;
+        double residual = sampling->set_hits[i] - r * sampling->set_accesses[i];
+        residual_ss += residual * residual;
+    }
+
+    double hits = hot_hits + r * rest_accesses;
+    estimate->accesses = accesses;
+    estimate->hit_ratio = accesses > 0 ? hits / accesses : 0.0;
+    estimate->misses = accesses - hits;
+    estimate->hit_ratio_ci95 = 0.0;
+    estimate->misses_ci95 = 0.0;
+    if (n > 1 && n < N && accesses > 0) {
+        double var_hits = N * N * (1.0 - n / N) * residual_ss / ((n - 1) * n);
+        estimate->misses_ci95 = t_95(n - 1) * sqrt(var_hits);
+        estimate->hit_ratio_ci95 = estimate->misses_ci95 / accesses;
+    }
+}
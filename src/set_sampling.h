@@ -0,0 +1,112 @@
+//
+// This file defines the struct and function signatures for statistical set
+// sampling. When sampling is enabled, only a subset of the sets is simulated:
+// cache_system_mem_access drops accesses to the other sets right after
+// decoding the address (only counting them), and only runs the prefetcher for
+// their demand accesses (as if they hit), since its prefetches may go to
+// simulated sets. The statistics of the simulated sets are then used to
+// estimate the hit ratio and the misses of the whole cache, with 95%
+// confidence intervals.
+//
+// The sets are chosen after a pilot, during which every set is simulated for
+// the first SET_SAMPLING_PILOT_PER_SET demand accesses per set. Out of a budget
+// of about num_sets / rate sets (at least SET_SAMPLING_MIN_SETS), the hottest
+// sets of the pilot (with at least SET_SAMPLING_HOT_FACTOR times the mean
+// number of accesses, up to half the budget) are always simulated. The rest of
+// the budget is a random sample of the other sets, chosen by a seeded hash of
+// the set index. Skewed traces concentrate their accesses in a few sets, and
+// leaving those to chance is what makes a plain random sample of sets
+// unreliable.
+//
+// The number of accesses of every set is known, so the hits of the sampled
+// stratum are estimated with a ratio estimator:
+//
+//      H = H_hot + r * A_rest,    r = sum_i h_i / sum_i a_i
+//      var(H) = N^2 * (1 - n/N) * sum_i (h_i - r * a_i)^2 / ((n - 1) * n)
+//
+// where n of the N non-hot sets are sampled, a_i and h_i are the accesses and
+// hits of sampled set i, H_hot are the hits of the hot sets, and A_rest are
+// the accesses of every non-hot set. The hit ratio is H over all accesses. The
+// intervals use Student's t quantile with n - 1 degrees of freedom. They only
+// cover the choice of sets: they do not account for the prefetches that the
+// unsampled sets would have issued on a miss.
+//
+
+#ifndef SET_SAMPLING_H
+#define SET_SAMPLING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SET_SAMPLING_PILOT_PER_SET 16
+#define SET_SAMPLING_MIN_SETS 64
+#define SET_SAMPLING_HOT_FACTOR 4
+
+// What is simulated of a set.
+enum set_sampling_kind {
+    SET_SAMPLING_SKIPPED = 0, // Only its accesses are counted
+    SET_SAMPLING_RANDOM = 1,  // Part of the random sample (every set during the pilot)
+    SET_SAMPLING_HOT = 2,     // Always simulated
+};
+
+struct set_sampling {
+    uint32_t rate;        // Roughly one in `rate` sets is simulated
+    uint32_t seed;        // Seed of the hash that picks the random sample
+    uint32_t num_sets;    // Total number of sets in the cache
+    uint32_t num_sampled; // Number of sets that are simulated (after the pilot)
+    uint32_t num_hot;     // Number of those that are hot sets
+    uint8_t *sampled;     // For each set, an enum set_sampling_kind
+
+    // Demand accesses seen so far, and the number at which the pilot ends.
+    uint64_t accesses;
+    uint64_t pilot_end;
+    bool pilot; // Whether every set is still simulated
+
+    // Per-set demand accesses (of every set) and hits (of simulated sets).
+    uint64_t *set_accesses;
+    uint64_t *set_hits;
+};
+
+// Estimates of whole-cache statistics from the sampled sets.
+struct set_sampling_estimate {
+    double accesses;       // Demand accesses (exact: every access is counted)
+    double hit_ratio;      // Estimated hit ratio
+    double hit_ratio_ci95; // Half-width of the 95% confidence interval of the hit ratio
+    double misses;         // Estimated number of misses
+    double misses_ci95;    // Half-width of the 95% confidence interval of the misses
+};
+
+// Start sampling one in about `rate` sets. The random sample depends on `seed`.
+struct set_sampling *set_sampling_new(uint32_t num_sets, uint32_t rate, uint32_t seed);
+void set_sampling_cleanup(struct set_sampling *sampling);
+
+// Choose the simulated sets at the end of the pilot.
+void set_sampling_select(struct set_sampling *sampling);
+
+// Whether the given set is simulated.
+static inline bool set_sampling_includes(struct set_sampling *sampling, uint32_t set_idx)
+{
+    return sampling->sampled[set_idx] != SET_SAMPLING_SKIPPED;
+}
+
+// Count a demand access to any set (before checking whether it is simulated).
+static inline void set_sampling_access(struct set_sampling *sampling, uint32_t set_idx)
+{
+    sampling->set_accesses[set_idx]++;
+    if (++sampling->accesses == sampling->pilot_end) set_sampling_select(sampling);
+}
+
+// Record a demand hit in a simulated set.
+static inline void set_sampling_hit(struct set_sampling *sampling, uint32_t set_idx)
+{
+    sampling->set_hits[set_idx]++;
+}
+
+// Forget the per-set counts (e.g. when the statistics are reset after a warmup).
+// The choice of sets is kept.
+void set_sampling_reset(struct set_sampling *sampling);
+
+// Compute the whole-cache estimates from the per-set counts.
+void set_sampling_estimate(struct set_sampling *sampling, struct set_sampling_estimate *estimate);
+
+#endif
@@ -0,0 +1,358 @@
+//
+// This file contains the implementations for the functions defined in
+// simpoint.h.
+//
+// The signatures are computed in a single streaming pass without building the
+// per-interval histograms: every region and stride is mapped to a fixed random
+// vector (derived from a hash of it), and an interval's signature is the mean
+// of the vectors of its accesses. This is the same random projection that
+// SimPoint applies to its basic block vectors.
+//
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "options.h"
+#include "simpoint.h"
+#include "trace.h"
+
+#define SIMPOINT_LINE_BITS 6 // Strides are measured in 64B lines
+#define SIMPOINT_STRIDE_KEY (1ull << 40)
+#define SIMPOINT_MAX_ITERATIONS 100
+
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// A uniformly random double in [0, 1).
+static double unit_random(uint64_t *state)
+{
+    *state = splitmix64(*state);
+    return (*state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Add the random vector of `key` to the signature.
+static void project(double *signature, uint32_t dims, uint64_t key, uint64_t seed)
+{
+    uint64_t state = splitmix64(key ^ seed);
+    for (uint32_t j = 0; j < dims; j++) {
+        signature[j] += unit_random(&state) * 2 - 1;
+    }
+}
+
+// The key of the stride between two consecutive lines: its sign and the
+// number of bits of its magnitude.
+static uint64_t stride_key(uint32_t previous_line, uint32_t line)
+{
+    int64_t stride = (int64_t)line - previous_line;
+    uint64_t magnitude = stride < 0 ? -stride : stride;
+    uint32_t bits = magnitude == 0 ? 0 : 64 - __builtin_clzll(magnitude);
+    return SIMPOINT_STRIDE_KEY | (stride < 0) << 7 | bits;
+}
+
+static double distance2(double *a, double *b, uint32_t dims)
+{
+    double sum = 0;
+    for (uint32_t j = 0; j < dims; j++) {
+        sum += (a[j] - b[j]) * (a[j] - b[j]);
+    }
+    return sum;
+}
+
+// Cluster the n signatures into k clusters with k-means++ seeding followed by
+// Lloyd's iterations. Fills in the cluster of every signature.
+static void kmeans(double *signatures, uint64_t n, uint32_t dims, uint32_t k, uint64_t seed,
+                   uint32_t *assignment, double *centroids)
+{
+    uint64_t state = seed;
+    double *nearest = malloc(n * sizeof(double));
+    memcpy(centroids, &signatures[(uint64_t)(unit_random(&state) * n) * dims],
+           dims * sizeof(double));
+    for (uint64_t i = 0; i < n; i++) {
+        nearest[i] = distance2(&signatures[i * dims], centroids, dims);
+    }
+    for (uint32_t c = 1; c < k; c++) {
+        // Choose the next centroid with probability proportional to the
+        // squared distance from the closest centroid so far.
+        double total = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            total += nearest[i];
+        }
+        double target = unit_random(&state) * total;
+        uint64_t chosen = n - 1;
+        for (uint64_t i = 0; i < n; i++) {
+            target -= nearest[i];
+            if (target < 0) {
+                chosen = i;
+                break;
+            }
+        }
+        double *centroid = &centroids[c * dims];
+        memcpy(centroid, &signatures[chosen * dims], dims * sizeof(double));
+        for (uint64_t i = 0; i < n; i++) {
+            double d = distance2(&signatures[i * dims], centroid, dims);
+            if (d < nearest[i]) nearest[i] = d;
+        }
+    }
+    free(nearest);
+
+    uint64_t *sizes = malloc(k * sizeof(uint64_t));
+    for (uint64_t i = 0; i < n; i++) {
+        assignment[i] = UINT32_MAX;
+    }
+    for (uint32_t iteration = 0; iteration < SIMPOINT_MAX_ITERATIONS; iteration++) {
+        bool changed = false;
+        for (uint64_t i = 0; i < n; i++) {
+            uint32_t best = 0;
+            double best_distance = DBL_MAX;
+            for (uint32_t c = 0; c < k; c++) {
+                double d = distance2(&signatures[i * dims], &centroids[c * dims], dims);
+                if (d < best_distance) {
+                    best = c;
+                    best_distance = d;
+                }
+            }
+            changed |= assignment[i] != best;
+            assignment[i] = best;
+        }
+        if (!changed) break;
+
+        // Move every centroid to the mean of its cluster. An empty cluster
+        // keeps its centroid.
+        memset(sizes, 0, k * sizeof(uint64_t));
+        for (uint64_t i = 0; i < n; i++) {
+            sizes[assignment[i]]++;
+        }
+        for (uint32_t c = 0; c < k; c++) {
+            if (sizes[c] > 0) memset(&centroids[c * dims], 0, dims * sizeof(double));
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            double *centroid = &centroids[assignment[i] * dims];
+            for (uint32_t j = 0; j < dims; j++) {
+                centroid[j] += signatures[i * dims + j] / sizes[assignment[i]];
+            }
+        }
+    }
+    free(sizes);
+}
+
+static int compare_simpoints(const void *a, const void *b)
+{
+    uint64_t x = ((const struct simpoint *)a)->interval_index;
+    uint64_t y = ((const struct simpoint *)b)->interval_index;
+    return (x > y) - (x < y);
+}
+
+int simpoint_main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: cachesim simpoint <interval> [--k=N] [--dims=N] "
+                        "[--region-size=BYTES] [--seed=N] < <trace_file>\n");
+        return 1;
+    }
+    uint64_t interval = strtoull(argv[1], NULL, 10);
+    uint32_t k = 10;
+    uint32_t dims = 15;
+    uint32_t region_size = 4096;
+    uint64_t seed = 1;
+    for (int i = 2; i < argc; i++) {
+        const char *value;
+        if ((value = option_value(argv[i], "k"))) {
+            k = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "dims"))) {
+            dims = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "region-size"))) {
+            region_size = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "seed"))) {
+            seed = strtoull(value, NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (interval == 0 || k == 0 || k > SIMPOINT_MAX_K || dims == 0 ||
+        dims > SIMPOINT_MAX_DIMS || region_size == 0 || (region_size & (region_size - 1))) {
+        fprintf(stderr, "The interval must be non-zero, --k at most %d, --dims at most %d, and "
+                        "--region-size a power of two\n",
+                SIMPOINT_MAX_K, SIMPOINT_MAX_DIMS);
+        return 1;
+    }
+    uint32_t region_bits = __builtin_ctz(region_size);
+
+    // Compute the signature of every interval.
+    uint64_t capacity = 1024;
+    double *signatures = malloc(capacity * dims * sizeof(double));
+    uint64_t n = 0;
+    uint64_t in_interval = 0;
+    uint32_t previous_line = 0;
+    struct trace_reader *reader = malloc(sizeof(struct trace_reader));
+    trace_reader_init_file(reader, stdin);
+    struct trace_record record;
+    while (trace_reader_next(reader, &record)) {
+        if (in_interval == 0) {
+            if (n == capacity) {
+                capacity *= 2;
+                signatures = realloc(signatures, capacity * dims * sizeof(double));
+            }
+            memset(&signatures[n * dims], 0, dims * sizeof(double));
+            n++;
+        }
+        double *signature = &signatures[(n - 1) * dims];
+        uint32_t line = record.address >> SIMPOINT_LINE_BITS;
+        project(signature, dims, record.address >> region_bits, seed);
+        if (reader->position > 1) {
+            project(signature, dims, stride_key(previous_line, line), seed);
+        }
+        previous_line = line;
+        if (++in_interval == interval) in_interval = 0;
+    }
+    if (reader->malformed) return 1;
+    if (n == 0) {
+        fprintf(stderr, "The trace is empty\n");
+        return 1;
+    }
+    // Use the mean so that a partial last interval is comparable.
+    uint64_t *lengths = malloc(n * sizeof(uint64_t));
+    for (uint64_t i = 0; i < n; i++) {
+        lengths[i] = i == n - 1 && in_interval > 0 ? in_interval : interval;
+        for (uint32_t j = 0; j < dims; j++) {
+            signatures[i * dims + j] /= lengths[i];
+        }
+    }
+
+    if (k > n) k = n;
+    uint32_t *assignment = malloc(n * sizeof(uint32_t));
+    double *centroids = malloc(k * dims * sizeof(double));
+    kmeans(signatures, n, dims, k, seed, assignment, centroids);
+
+    // The simpoint of a cluster is the interval closest to its centroid, and
+    // its weight is the share of the records in the cluster.
+    struct simpoint *points = calloc(k, sizeof(struct simpoint));
+    double *closest = malloc(k * sizeof(double));
+    for (uint32_t c = 0; c < k; c++) {
+        closest[c] = DBL_MAX;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        uint32_t c = assignment[i];
+        double d = distance2(&signatures[i * dims], &centroids[c * dims], dims);
+        if (d < closest[c]) {
+            closest[c] = d;
+            points[c].interval_index = i;
+        }
+        points[c].weight += (double)lengths[i] / reader->position;
+    }
+    uint32_t count = 0;
+    for (uint32_t c = 0; c < k; c++) {
+        if (points[c].weight > 0) points[count++] = points[c];
+    }
+    qsort(points, count, sizeof(struct simpoint), compare_simpoints);
+
+    printf("# cachesim simpoints\n");
+    printf("interval %lu\n", (unsigned long)interval);
+    printf("intervals %lu\n", (unsigned long)n);
+    printf("records %lu\n", (unsigned long)reader->position);
+    printf("hash %016lx\n", (unsigned long)reader->hash);
+    for (uint32_t i = 0; i < count; i++) {
+        printf("%lu %.8f\n", (unsigned long)points[i].interval_index, points[i].weight);
+    }
+
+    free(reader);
+    free(signatures);
+    free(lengths);
+    free(assignment);
+    free(centroids);
+    free(points);
+    free(closest);
+    return 0;
+}
+
+struct simpoints *simpoints_load(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    struct simpoints *simpoints = calloc(1, sizeof(struct simpoints));
+    unsigned long interval, total_intervals, records, hash;
+    if (fscanf(file, "# cachesim simpoints interval %lu intervals %lu records %lu hash %lx",
+               &interval, &total_intervals, &records, &hash) != 4 ||
+        interval == 0) {
+        fprintf(stderr, "%s is not a simpoints file\n", path);
+        fclose(file);
+        free(simpoints);
+        return NULL;
+    }
+    simpoints->interval = interval;
+    simpoints->total_intervals = total_intervals;
+    simpoints->records = records;
+    simpoints->hash = hash;
+
+    uint32_t capacity = 16;
+    simpoints->points = malloc(capacity * sizeof(struct simpoint));
+    unsigned long index;
+    double weight;
+    while (fscanf(file, "%lu %lf", &index, &weight) == 2) {
+        if (simpoints->count == capacity) {
+            capacity *= 2;
+            simpoints->points = realloc(simpoints->points, capacity * sizeof(struct simpoint));
+        }
+        if (index >= total_intervals ||
+            (simpoints->count > 0 &&
+             index <= simpoints->points[simpoints->count - 1].interval_index)) {
+            fprintf(stderr, "%s: the simpoints must be distinct intervals in trace order\n",
+                    path);
+            fclose(file);
+            simpoints_cleanup(simpoints);
+            free(simpoints);
+            return NULL;
+        }
+        simpoints->points[simpoints->count].interval_index = index;
+        simpoints->points[simpoints->count].weight = weight;
+        simpoints->count++;
+    }
+    fclose(file);
+    if (simpoints->count == 0) {
+        fprintf(stderr, "%s does not contain any simpoints\n", path);
+        simpoints_cleanup(simpoints);
+        free(simpoints);
+        return NULL;
+    }
+
+    simpoints->estimate = calloc(cache_system_num_stat_fields, sizeof(double));
+    return simpoints;
+}
+
+void simpoints_cleanup(struct simpoints *simpoints)
+{
+    free(simpoints->points);
+    free(simpoints->estimate);
+}
+
+void simpoints_add(struct simpoints *simpoints, uint32_t point, uint64_t length,
+                   struct cache_system_stats *before, struct cache_system_stats *after)
+{
+    if (length == 0) return;
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        uint64_t delta = cache_system_stat(after, &cache_system_stat_fields[f]) -
+                         cache_system_stat(before, &cache_system_stat_fields[f]);
+        simpoints->estimate[f] += simpoints->points[point].weight * delta / length;
+    }
+}
+
+void simpoints_estimate(struct simpoints *simpoints, struct cache_system_stats *stats)
+{
+    for (size_t f = 0; f < cache_system_num_stat_fields; f++) {
+        cache_system_stat_set(stats, &cache_system_stat_fields[f],
+                              (uint64_t)llround(simpoints->estimate[f] * simpoints->records));
+    }
+}
@@ -0,0 +1,67 @@
+//
+// This file defines the `simpoint` subcommand and the structs and function
+// signatures for simulating only the representative intervals it selects.
+//
+// The subcommand splits a trace (from stdin) into fixed-size intervals and
+// computes a signature for each of them: the accessed regions and the line
+// strides between consecutive accesses, randomly projected down to a few
+// dimensions. It clusters the signatures with k-means and writes, for every
+// cluster, the interval closest to its centroid along with the fraction of the
+// trace records in the cluster (its weight):
+//
+//      cachesim simpoint <interval> [--k=N] [--dims=N] [--region-size=BYTES]
+//                        [--seed=N] < <trace_file> > <simpoints_file>
+//
+// The simulator then runs only those intervals (`--simpoints=<file>`), each
+// preceded by a warmup, and estimates the statistics of the whole trace from
+// the weighted sum of their per-record statistics, so that a partial last
+// interval counts for its actual length.
+//
+// The simpoints file is plain text: a header with the interval size, the
+// number of intervals, and the length and hash of the trace, followed by one
+// `<interval index> <weight>` line per simpoint, in trace order.
+//
+
+#ifndef SIMPOINT_H
+#define SIMPOINT_H
+
+#include <stdint.h>
+
+#include "memory_system.h"
+
+#define SIMPOINT_MAX_K 1024
+#define SIMPOINT_MAX_DIMS 64
+
+struct simpoint {
+    uint64_t interval_index;
+    double weight;
+};
+
+struct simpoints {
+    uint64_t interval;        // Records per interval
+    uint64_t total_intervals; // Intervals in the whole trace (the last may be partial)
+    uint64_t records;         // Length of the trace the simpoints were chosen for
+    uint64_t hash;            // Hash of that trace (as computed by the trace reader)
+
+    struct simpoint *points; // Sorted by interval index
+    uint32_t count;
+
+    double *estimate; // Weighted sum of the per-record statistics, per stat field
+};
+
+// Run the subcommand. argv[0] is "simpoint". Returns the exit status.
+int simpoint_main(int argc, char **argv);
+
+// Load a simpoints file. Returns NULL (after printing an error) on failure.
+struct simpoints *simpoints_load(const char *path);
+void simpoints_cleanup(struct simpoints *simpoints);
+
+// Add the statistics of simpoint `point`, which went from `before` to
+// `after` over the `length` records of its interval, to the estimate.
+void simpoints_add(struct simpoints *simpoints, uint32_t point, uint64_t length,
+                   struct cache_system_stats *before, struct cache_system_stats *after);
+
+// Store the estimate of the statistics of the whole trace into `stats`.
+void simpoints_estimate(struct simpoints *simpoints, struct cache_system_stats *stats);
+
+#endif
@@ -0,0 +1,145 @@
+//
+// This file contains the implementations for the functions defined in
+// stream_buffer.h.
+//
+
+#include <stdlib.h>
+
+#include "line_map.h"
+#include "memory_system.h"
+#include "stream_buffer.h"
+
+struct stream_buffers *stream_buffers_new(uint32_t num_buffers, uint32_t depth,
+                                          uint32_t line_size)
+{
+    struct stream_buffers *stream_buffers = calloc(1, sizeof(struct stream_buffers));
+    stream_buffers->num_buffers = num_buffers;
+    stream_buffers->depth = depth;
+    stream_buffers->line_size = line_size;
+    stream_buffers->buffers = calloc(num_buffers, sizeof(struct stream_buffer));
+    for (uint32_t i = 0; i < num_buffers; i++) {
+        stream_buffers->buffers[i].lines = calloc(depth, sizeof(uint32_t));
+    }
+    stream_buffers->index = line_map_new(num_buffers * depth);
+    return stream_buffers;
+}
+
+void stream_buffers_cleanup(struct stream_buffers *stream_buffers)
+{
+    for (uint32_t i = 0; i < stream_buffers->num_buffers; i++) {
+        free(stream_buffers->buffers[i].lines);
+    }
+    free(stream_buffers->buffers);
+    line_map_cleanup(stream_buffers->index);
+    free(stream_buffers->index);
+}
+
+// Drop the oldest line of the buffer.
+static void stream_buffer_pop(struct stream_buffers *stream_buffers, struct stream_buffer *buffer)
+{
+    line_map_remove(stream_buffers->index, buffer->lines[buffer->head]);
+    buffer->head = (buffer->head + 1) % stream_buffers->depth;
+    buffer->count--;
+}
+
+// Fetch `line_id` from the next level into the tail of the buffer.
+static void stream_buffer_push(struct stream_buffers *stream_buffers, struct stream_buffer *buffer,
+                               uint32_t line_id, struct cache_system_stats *stats)
+{
+    // A line may only be in one buffer at a time.
+    if (line_map_get(stream_buffers->index, line_id) != NULL) return;
+
+    if (buffer->count == stream_buffers->depth) {
+        stream_buffer_pop(stream_buffers, buffer);
+    }
+    uint32_t position = (buffer->head + buffer->count) % stream_buffers->depth;
+    buffer->lines[position] = line_id;
+    buffer->count++;
+    line_map_put(stream_buffers->index, line_id,
+                 (uint64_t)(buffer - stream_buffers->buffers) * stream_buffers->depth + position);
+
+    stats->stream_buffer_prefetches++;
+    stats->bytes_read += stream_buffers->line_size;
+    stats->prefetch_bytes_read += stream_buffers->line_size;
+}
+
+// Fill the buffer up to its depth with the following lines of its stream.
+static void stream_buffer_refill(struct stream_buffers *stream_buffers,
+                                 struct stream_buffer *buffer, struct cache_system_stats *stats)
+{
+    while (buffer->count < stream_buffers->depth) {
+        stream_buffer_push(stream_buffers, buffer, buffer->next_line++, stats);
+    }
+}
+
+static struct stream_buffer *stream_buffers_lru(struct stream_buffers *stream_buffers)
+{
+    struct stream_buffer *lru = &stream_buffers->buffers[0];
+    for (uint32_t i = 1; i < stream_buffers->num_buffers; i++) {
+        if (stream_buffers->buffers[i].last_use < lru->last_use) {
+            lru = &stream_buffers->buffers[i];
+        }
+    }
+    return lru;
+}
+
+bool stream_buffers_contains(struct stream_buffers *stream_buffers, uint32_t line_id)
+{
+    return line_map_get(stream_buffers->index, line_id) != NULL;
+}
+
+bool stream_buffers_take(struct stream_buffers *stream_buffers, uint32_t line_id, bool refill,
+                         struct cache_system_stats *stats)
+{
+    uint64_t *location = line_map_get(stream_buffers->index, line_id);
+    if (location == NULL) return false;
+
+    struct stream_buffer *buffer = &stream_buffers->buffers[*location / stream_buffers->depth];
+    uint32_t position = *location % stream_buffers->depth;
+    uint32_t taken = (position + stream_buffers->depth - buffer->head) % stream_buffers->depth + 1;
+    for (uint32_t i = 0; i < taken; i++) {
+        stream_buffer_pop(stream_buffers, buffer);
+    }
+    buffer->last_use = ++stream_buffers->clock;
+    if (refill) {
+        stream_buffer_refill(stream_buffers, buffer, stats);
+    }
+    return true;
+}
+
+void stream_buffers_allocate(struct stream_buffers *stream_buffers, uint32_t line_id,
+                             struct cache_system_stats *stats)
+{
+    struct stream_buffer *buffer = stream_buffers_lru(stream_buffers);
+    while (buffer->count > 0) {
+        stream_buffer_pop(stream_buffers, buffer);
+    }
+    buffer->next_line = line_id;
+    buffer->last_use = ++stream_buffers->clock;
+    stream_buffer_refill(stream_buffers, buffer, stats);
+}
+
+void stream_buffers_insert(struct stream_buffers *stream_buffers, uint32_t line_id,
+                           struct cache_system_stats *stats)
+{
+    if (stream_buffers_contains(stream_buffers, line_id)) return;
+
+    struct stream_buffer *buffer = NULL;
+    for (uint32_t i = 0; i < stream_buffers->num_buffers; i++) {
+        struct stream_buffer *candidate = &stream_buffers->buffers[i];
+        if (candidate->count > 0 && candidate->next_line == line_id) {
+            buffer = candidate;
+            break;
+        }
+    }
+    if (buffer == NULL) {
+        buffer = stream_buffers_lru(stream_buffers);
+        while (buffer->count > 0) {
+            stream_buffer_pop(stream_buffers, buffer);
+        }
+    }
+
+    stream_buffer_push(stream_buffers, buffer, line_id, stats);
+    buffer->next_line = line_id + 1;
+    buffer->last_use = ++stream_buffers->clock;
+}
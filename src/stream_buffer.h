@@ -0,0 +1,73 @@
+//
+// This file defines the structs and function signatures for Jouppi-style
+// stream buffers: a few small FIFOs of prefetched lines that sit next to the
+// main cache array, so that prefetched lines never evict anything from it.
+//
+// A line is only moved into the main array when a demand miss finds it in a
+// stream buffer. The lines ahead of it in the same buffer are dropped, since
+// the stream skipped them.
+//
+// The stream buffers are filled in one of two ways:
+//  * On their own (the default): a demand miss that is not in any stream
+//    buffer flushes the least recently used buffer and restarts it at the next
+//    sequential line. A buffer hit tops the buffer back up to its depth.
+//  * By the prefetcher (when prefetches target the stream buffers): every
+//    prefetched line is appended to the buffer that continues its stream (the
+//    one whose next line it is), or to the least recently used buffer
+//    otherwise, dropping the oldest line of a full buffer.
+//
+// A line_map from the line ID to its buffer and position makes lookups O(1).
+//
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct cache_system_stats;
+
+#define STREAM_BUFFER_MAX_BUFFERS 64
+#define STREAM_BUFFER_MAX_DEPTH 64
+
+struct stream_buffer {
+    uint32_t *lines; // A ring of `depth` line IDs, oldest at `head`
+    uint32_t head;
+    uint32_t count;
+    uint32_t next_line; // The line that continues the stream
+    uint64_t last_use;  // For choosing the least recently used buffer
+};
+
+struct stream_buffers {
+    uint32_t num_buffers;
+    uint32_t depth;
+    uint32_t line_size;
+    struct stream_buffer *buffers;
+    struct line_map *index; // Line ID -> buffer * depth + position in the ring
+    uint64_t clock;
+};
+
+struct stream_buffers *stream_buffers_new(uint32_t num_buffers, uint32_t depth,
+                                          uint32_t line_size);
+void stream_buffers_cleanup(struct stream_buffers *stream_buffers);
+
+// Returns whether the line is in any of the stream buffers.
+bool stream_buffers_contains(struct stream_buffers *stream_buffers, uint32_t line_id);
+
+// If the line is in a stream buffer, remove it (along with the lines ahead of
+// it in the buffer) and return true. With `refill`, the buffer is then topped
+// back up with the following lines of its stream.
+bool stream_buffers_take(struct stream_buffers *stream_buffers, uint32_t line_id, bool refill,
+                         struct cache_system_stats *stats);
+
+// Flush the least recently used buffer and fill it with the lines starting at
+// `line_id`.
+void stream_buffers_allocate(struct stream_buffers *stream_buffers, uint32_t line_id,
+                             struct cache_system_stats *stats);
+
+// Append a prefetched line to the buffer continuing its stream (or the least
+// recently used buffer).
+void stream_buffers_insert(struct stream_buffers *stream_buffers, uint32_t line_id,
+                           struct cache_system_stats *stats);
+
+#endif
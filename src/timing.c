@@ -0,0 +1,186 @@
+//
+// This file contains the implementations for the functions defined in
+// timing.h.
+//
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timing.h"
+
+struct timing_model *timing_model_new(struct timing_config *config)
+{
+    struct timing_model *timing = calloc(1, sizeof(struct timing_model));
+    timing->config = *config;
+    timing->mshrs = calloc(config->mshrs, sizeof(struct timing_mshr));
+    return timing;
+}
+
+void timing_model_cleanup(struct timing_model *timing)
+{
+    free(timing->mshrs);
+}
+
+static uint64_t max_cycle(uint64_t a, uint64_t b)
+{
+    return a > b ? a : b;
+}
+
+// Cycles the memory bus is busy transferring `bytes`.
+static uint64_t timing_transfer_cycles(struct timing_model *timing, uint32_t bytes)
+{
+    return (uint64_t)ceil(bytes / timing->config.bandwidth);
+}
+
+static void timing_remove_mshr(struct timing_model *timing, uint32_t index)
+{
+    timing->mshrs[index] = timing->mshrs[--timing->outstanding];
+}
+
+// Free the MSHRs whose fills completed by `cycle`.
+static void timing_retire(struct timing_model *timing, uint64_t cycle)
+{
+    for (uint32_t i = 0; i < timing->outstanding;) {
+        if (timing->mshrs[i].ready <= cycle) {
+            timing_remove_mshr(timing, i);
+        } else {
+            i++;
+        }
+    }
+}
+
+// Find the MSHR whose fill brings the given sector of the line.
+static struct timing_mshr *timing_find_mshr(struct timing_model *timing, uint32_t line_id,
+                                            uint32_t sector)
+{
+    for (uint32_t i = 0; i < timing->outstanding; i++) {
+        struct timing_mshr *mshr = &timing->mshrs[i];
+        if (mshr->line_id == line_id && (mshr->sectors & sector)) return mshr;
+    }
+    return NULL;
+}
+
+// Returns the first cycle, no earlier than `cycle`, at which an MSHR is free.
+// If every MSHR is busy, the one that completes first is freed.
+static uint64_t timing_wait_for_mshr(struct timing_model *timing, uint64_t cycle)
+{
+    if (timing->outstanding < timing->config.mshrs) return cycle;
+
+    timing->stats.mshr_full_waits++;
+    uint32_t earliest = 0;
+    for (uint32_t i = 1; i < timing->outstanding; i++) {
+        if (timing->mshrs[i].ready < timing->mshrs[earliest].ready) earliest = i;
+    }
+    uint64_t free_cycle = max_cycle(cycle, timing->mshrs[earliest].ready);
+    timing_remove_mshr(timing, earliest);
+    return free_cycle;
+}
+
+// Transfer `bytes` over the memory bus, starting no earlier than `cycle`.
+// Returns the cycle at which the transfer completes.
+static uint64_t timing_bus_transfer(struct timing_model *timing, uint64_t cycle, uint32_t bytes)
+{
+    uint64_t start = max_cycle(cycle, timing->bus_free);
+    timing->bus_free = start + timing_transfer_cycles(timing, bytes);
+    return timing->bus_free;
+}
+
+void timing_access(struct timing_model *timing, uint32_t line_id, uint32_t sector, char rw,
+                   bool is_prefetch, bool hit, uint32_t fill_bytes, uint32_t background_bytes,
+                   uint32_t bytes_written)
+{
+    // Prefetches are triggered by the demand access before them, so they are
+    // issued when it was, and they never hold up the core.
+    uint64_t issue = is_prefetch ? timing->last_issue : timing->now;
+    uint64_t hit_latency = timing->config.hit_latency;
+    uint64_t data_ready = issue + hit_latency; // When the data reaches the core
+    uint64_t issued = issue;                   // When the access left the core
+
+    timing_retire(timing, issue);
+    struct timing_mshr *mshr = timing_find_mshr(timing, line_id, sector);
+    if (mshr != NULL) {
+        // The sector is still on its way from memory: wait for the rest of it.
+        timing->stats.mshr_merges++;
+        data_ready = max_cycle(data_ready, mshr->ready + hit_latency);
+    } else if (!hit && fill_bytes > 0) {
+        issued = timing_wait_for_mshr(timing, issue);
+        uint64_t ready = timing_bus_transfer(timing, issued + timing->config.miss_latency,
+                                             fill_bytes);
+        struct timing_mshr *allocated = &timing->mshrs[timing->outstanding++];
+        allocated->line_id = line_id;
+        allocated->sectors = sector;
+        allocated->ready = ready;
+        timing->stats.mshr_busy_cycles += ready - issued;
+        data_ready = ready + hit_latency;
+    }
+
+    // The rest of the traffic only occupies the memory bus.
+    if (background_bytes > 0) timing_bus_transfer(timing, issue, background_bytes);
+    if (bytes_written > 0) timing_bus_transfer(timing, issue, bytes_written);
+
+    if (is_prefetch) return;
+
+    // Reads block until their data arrives. Writes are posted, but may have
+    // had to wait for an MSHR before they could leave the core.
+    uint64_t done = rw == 'W' ? issued + hit_latency : data_ready;
+    timing->stats.demand_accesses++;
+    timing->stats.demand_latency += done - issue;
+    timing->stats.stall_cycles += done - issue - hit_latency;
+    timing->last_issue = issue;
+    timing->now = done;
+}
+
+void timing_reset_stats(struct timing_model *timing)
+{
+    memset(&timing->stats, 0, sizeof(struct timing_stats));
+    timing->stats.start_cycle = timing->now;
+}
+
+uint64_t timing_cycles(struct timing_model *timing)
+{
+    // The run ends once the posted writes and the outstanding fills are done.
+    uint64_t end = max_cycle(timing->now, timing->bus_free);
+    for (uint32_t i = 0; i < timing->outstanding; i++) {
+        end = max_cycle(end, timing->mshrs[i].ready);
+    }
+    return end - timing->stats.start_cycle;
+}
+
+double timing_amat(struct timing_model *timing)
+{
+    struct timing_stats *stats = &timing->stats;
+    return stats->demand_accesses == 0 ? 0.0
+                                       : (double)stats->demand_latency / stats->demand_accesses;
+}
+
+double timing_mshr_occupancy(struct timing_model *timing)
+{
+    uint64_t cycles = timing_cycles(timing);
+    return cycles == 0 ? 0.0 : (double)timing->stats.mshr_busy_cycles / cycles;
+}
+
+void timing_print_text(FILE *out, struct timing_model *timing)
+{
+    struct timing_stats *stats = &timing->stats;
+    fprintf(out, "OUTPUT CYCLES %lu\n", (unsigned long)timing_cycles(timing));
+    fprintf(out, "OUTPUT AMAT %.4f\n", timing_amat(timing));
+    fprintf(out, "OUTPUT STALL CYCLES %lu\n", (unsigned long)stats->stall_cycles);
+    fprintf(out, "OUTPUT MSHR MERGES %lu\n", (unsigned long)stats->mshr_merges);
+    fprintf(out, "OUTPUT MSHR FULL WAITS %lu\n", (unsigned long)stats->mshr_full_waits);
+    fprintf(out, "OUTPUT MSHR OCCUPANCY %.4f\n", timing_mshr_occupancy(timing));
+}
+
+void timing_print_json(FILE *out, struct timing_model *timing)
+{
+    struct timing_config *config = &timing->config;
+    struct timing_stats *stats = &timing->stats;
+    fprintf(out,
+            "\"timing\": {\"hit_latency\": %u, \"miss_latency\": %u, \"bandwidth\": %.4f, "
+            "\"mshrs\": %u, \"cycles\": %lu, \"amat\": %.4f, \"stall_cycles\": %lu, "
+            "\"mshr_merges\": %lu, \"mshr_full_waits\": %lu, \"mshr_occupancy\": %.4f}",
+            config->hit_latency, config->miss_latency, config->bandwidth, config->mshrs,
+            (unsigned long)timing_cycles(timing), timing_amat(timing),
+            (unsigned long)stats->stall_cycles, (unsigned long)stats->mshr_merges,
+            (unsigned long)stats->mshr_full_waits, timing_mshr_occupancy(timing));
+}
@@ -0,0 +1,97 @@
+//
+// This file defines the structs and function signatures for the optional
+// timing model that sits on top of cache_system_mem_access.
+//
+// The model is a blocking in-order core in front of the cache:
+//
+//  * Every demand read takes `hit_latency` cycles on a hit. On a miss that
+//    goes to memory, it waits for the line to arrive. Writes are posted and
+//    take `hit_latency` cycles unless they must wait for a free MSHR.
+//  * Misses to memory (including prefetches) are tracked in a finite file of
+//    miss status holding registers (MSHRs), keyed by line and sector. A miss
+//    to a sector that is already outstanding is merged into its MSHR, and a
+//    demand hit on a sector that is still in flight (e.g. a late prefetch)
+//    waits for the rest of its fill. A miss to another sector of the line
+//    needs its own fill, and so its own MSHR.
+//    When every MSHR is busy, the request waits for the earliest one to free
+//    up; a demand access stalls the core while it waits.
+//  * Memory has a fixed latency and a bandwidth limit. Fills, write-backs and
+//    write-through traffic share the memory bus, so prefetch traffic delays
+//    demand misses queued behind it.
+//
+// The statistics use 64-bit counters since the cycle counts of long traces do
+// not fit in the uint32_t statistics of the cache system.
+//
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TIMING_MAX_MSHRS 256
+
+struct timing_config {
+    uint32_t hit_latency;  // Cycles for a hit
+    uint32_t miss_latency; // Cycles for memory to return a line (without queueing)
+    double bandwidth;      // Bytes per cycle of the memory bus
+    uint32_t mshrs;        // Number of outstanding misses
+};
+
+struct timing_stats {
+    uint64_t demand_accesses;
+    uint64_t demand_latency;   // Sum of the latencies of the demand accesses
+    uint64_t stall_cycles;     // Cycles the core waited beyond the hit latency
+    uint64_t mshr_merges;      // Accesses merged into an outstanding MSHR
+    uint64_t mshr_full_waits;  // Requests that had to wait for a free MSHR
+    uint64_t mshr_busy_cycles; // Sum over MSHRs of the cycles they were allocated
+    uint64_t start_cycle;      // Cycle at which the statistics were last reset
+};
+
+struct timing_mshr {
+    uint32_t line_id;
+    uint32_t sectors; // The sectors of the line being filled
+    uint64_t ready; // Cycle at which the fill completes
+};
+
+struct timing_model {
+    struct timing_config config;
+    struct timing_stats stats;
+
+    uint64_t now;        // Cycle at which the core issues its next access
+    uint64_t last_issue; // Cycle at which the last demand access was issued
+    uint64_t bus_free;   // Cycle at which the memory bus becomes free
+
+    struct timing_mshr *mshrs; // The outstanding misses
+    uint32_t outstanding;
+};
+
+struct timing_model *timing_model_new(struct timing_config *config);
+void timing_model_cleanup(struct timing_model *timing);
+
+// Account for one access to the cache. `sector` is the bit of the accessed
+// sector (1 for lines without sectors), and `hit` is the outcome in the cache
+// array. The memory traffic caused by the access is split into `fill_bytes`
+// (the accessed line itself; a miss without them was served next to the
+// cache, e.g. by the victim cache), `background_bytes` (other reads, such as
+// stream buffer refills), and `bytes_written`.
+void timing_access(struct timing_model *timing, uint32_t line_id, uint32_t sector, char rw,
+                   bool is_prefetch, bool hit, uint32_t fill_bytes, uint32_t background_bytes,
+                   uint32_t bytes_written);
+
+// Reset the statistics (at the end of the warmup). The outstanding misses and
+// the state of the memory bus are kept.
+void timing_reset_stats(struct timing_model *timing);
+
+// Derived statistics.
+uint64_t timing_cycles(struct timing_model *timing);
+double timing_amat(struct timing_model *timing);
+double timing_mshr_occupancy(struct timing_model *timing);
+
+// Print the timing statistics as `OUTPUT ...` lines or as a JSON fragment
+// (`"timing": {...}`, without a leading comma).
+void timing_print_text(FILE *out, struct timing_model *timing);
+void timing_print_json(FILE *out, struct timing_model *timing);
+
+#endif
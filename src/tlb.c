@@ -0,0 +1,62 @@
+//
+// This file contains the implementations for the functions defined in tlb.h.
+//
+
+#include <stdlib.h>
+
+#include "tlb.h"
+
+static void tlb_level_init(struct tlb_level *level, uint32_t entries, uint32_t associativity)
+{
+    level->associativity = associativity;
+    level->sets = entries / associativity;
+    level->entries = calloc(entries, sizeof(struct tlb_entry));
+}
+
+struct tlb *tlb_new(struct tlb_config *config)
+{
+    struct tlb *tlb = calloc(1, sizeof(struct tlb));
+    tlb->config = *config;
+    tlb->page_bits = __builtin_ctz(config->page_size);
+    tlb_level_init(&tlb->l1, config->l1_entries, config->l1_associativity);
+    tlb_level_init(&tlb->l2, config->l2_entries, config->l2_associativity);
+    return tlb;
+}
+
+void tlb_cleanup(struct tlb *tlb)
+{
+    free(tlb->l1.entries);
+    free(tlb->l2.entries);
+}
+
+// Look the page up in the level, and install it (replacing the least recently
+// used entry of its set) if it is not there. Returns whether it was there.
+static bool tlb_level_access(struct tlb_level *level, uint32_t page, uint64_t clock)
+{
+    struct tlb_entry *set = &level->entries[(page & (level->sets - 1)) * level->associativity];
+    struct tlb_entry *victim = &set[0];
+    for (uint32_t i = 0; i < level->associativity; i++) {
+        if (set[i].valid && set[i].page == page) {
+            set[i].last_use = clock;
+            return true;
+        }
+        if (!set[i].valid) {
+            if (victim->valid) victim = &set[i];
+        } else if (victim->valid && set[i].last_use < victim->last_use) {
+            victim = &set[i];
+        }
+    }
+    victim->page = page;
+    victim->valid = true;
+    victim->last_use = clock;
+    return false;
+}
+
+enum tlb_result tlb_translate(struct tlb *tlb, uint32_t address)
+{
+    uint32_t page = address >> tlb->page_bits;
+    tlb->clock++;
+    if (tlb_level_access(&tlb->l1, page, tlb->clock)) return TLB_L1_HIT;
+    if (tlb_level_access(&tlb->l2, page, tlb->clock)) return TLB_L2_HIT;
+    return TLB_PAGE_WALK;
+}
@@ -0,0 +1,57 @@
+//
+// This file defines the structs and function signatures for a two-level TLB
+// model. Each level is set-associative with LRU replacement. A translation
+// that misses in both levels is counted as a page walk, after which the page
+// is installed in both levels.
+//
+// The page size is shared by both levels; huge pages (e.g. 2 MB) are modeled
+// by configuring a larger page size.
+//
+
+#ifndef TLB_H
+#define TLB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TLB_MAX_ENTRIES 65536
+
+struct tlb_config {
+    uint32_t l1_entries, l1_associativity;
+    uint32_t l2_entries, l2_associativity;
+    uint32_t page_size;
+};
+
+struct tlb_entry {
+    uint32_t page;
+    bool valid;
+    uint64_t last_use;
+};
+
+struct tlb_level {
+    uint32_t sets;
+    uint32_t associativity;
+    struct tlb_entry *entries; // `associativity` entries per set
+};
+
+struct tlb {
+    struct tlb_config config;
+    uint32_t page_bits;
+    struct tlb_level l1, l2;
+    uint64_t clock;
+};
+
+enum tlb_result {
+    TLB_L1_HIT,
+    TLB_L2_HIT,
+    TLB_PAGE_WALK,
+};
+
+// Create a new TLB. The numbers of sets of both levels must be powers of two.
+struct tlb *tlb_new(struct tlb_config *config);
+void tlb_cleanup(struct tlb *tlb);
+
+// Translate the address, filling the levels it missed in.
+enum tlb_result tlb_translate(struct tlb *tlb, uint32_t address);
+
+#endif
@@ -0,0 +1,188 @@
+//
+// This file contains the implementations for the functions defined in
+// trace.h.
+//
+// Each line of a trace file has the form `<R|W> <hex address> [core]`, e.g.
+// `R 0x10004` or `W 0x10004 3` for multi-core traces. The core ID must fit in
+// 16 bits. The parser is hand-written (instead of using scanf) because parsing
+// dominates the run time of the simulator on large traces.
+//
+
+#include <ctype.h>
+
+#include "profile.h"
+#include "trace.h"
+
+#define FNV_PRIME 0x100000001b3ull
+
+// Returns the next character of the file, or EOF.
+static int trace_reader_getc(struct trace_reader *reader)
+{
+    if (reader->buffer_pos == reader->buffer_len) {
+        reader->buffer_len = fread(reader->buffer, 1, TRACE_READ_BUFFER_SIZE, reader->file);
+        reader->buffer_pos = 0;
+        if (reader->buffer_len == 0) return EOF;
+    }
+    return (unsigned char)reader->buffer[reader->buffer_pos++];
+}
+
+// Returns the next character of the file without consuming it, or EOF.
+static int trace_reader_peek(struct trace_reader *reader)
+{
+    int c = trace_reader_getc(reader);
+    if (c != EOF) reader->buffer_pos--;
+    return c;
+}
+
+static int hex_digit_value(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool trace_reader_parse(struct trace_reader *reader, struct trace_record *record)
+{
+    int c;
+    if (reader->malformed) return false;
+
+    // Skip any whitespace (including blank lines) before the record.
+    do {
+        c = trace_reader_getc(reader);
+    } while (c != EOF && isspace(c));
+    if (c == EOF) return false;
+    record->rw = (char)c;
+
+    // Skip the whitespace between the R/W flag and the address.
+    while ((c = trace_reader_peek(reader)) == ' ' || c == '\t') {
+        trace_reader_getc(reader);
+    }
+
+    // Parse the address, with or without the 0x prefix.
+    uint32_t address = 0;
+    if (c == '0') {
+        trace_reader_getc(reader);
+        c = trace_reader_peek(reader);
+        if (c == 'x' || c == 'X') trace_reader_getc(reader);
+    }
+    int digit;
+    while ((digit = hex_digit_value(trace_reader_peek(reader))) >= 0) {
+        address = (address << 4) | digit;
+        trace_reader_getc(reader);
+    }
+    record->address = address;
+
+    // Parse the optional core ID, which must fit in 16 bits.
+    while ((c = trace_reader_peek(reader)) == ' ' || c == '\t') {
+        trace_reader_getc(reader);
+    }
+    uint32_t core = 0;
+    while ((c = trace_reader_peek(reader)) >= '0' && c <= '9') {
+        core = core * 10 + (c - '0');
+        trace_reader_getc(reader);
+        if (core > UINT16_MAX) {
+            fprintf(stderr, "Malformed trace record %zu: the core ID does not fit in 16 bits\n",
+                    reader->position + 1);
+            reader->malformed = true;
+            return false;
+        }
+    }
+    record->core = core;
+
+    // Discard the rest of the line.
+    while ((c = trace_reader_getc(reader)) != EOF && c != '\n')
+        ;
+    return true;
+}
+
+struct trace *trace_load(FILE *file)
+{
+    struct trace *trace = malloc(sizeof(struct trace));
+    trace->length = 0;
+    trace->capacity = 1024;
+    trace->records = malloc(trace->capacity * sizeof(struct trace_record));
+
+    struct trace_reader *reader = malloc(sizeof(struct trace_reader));
+    trace_reader_init_file(reader, file);
+
+    struct trace_record record;
+    while (trace_reader_next(reader, &record)) {
+        if (trace->length == trace->capacity) {
+            trace->capacity *= 2;
+            trace->records = realloc(trace->records, trace->capacity * sizeof(struct trace_record));
+        }
+        trace->records[trace->length++] = record;
+    }
+
+    bool malformed = reader->malformed;
+    free(reader);
+    if (malformed) {
+        trace_cleanup(trace);
+        free(trace);
+        return NULL;
+    }
+    return trace;
+}
+
+void trace_cleanup(struct trace *trace)
+{
+    free(trace->records);
+}
+
+void trace_reader_init_file(struct trace_reader *reader, FILE *file)
+{
+    reader->file = file;
+    reader->trace = NULL;
+    reader->position = 0;
+    reader->hash = TRACE_HASH_EMPTY;
+    reader->malformed = false;
+    reader->buffer_pos = 0;
+    reader->buffer_len = 0;
+}
+
+void trace_reader_init_trace(struct trace_reader *reader, struct trace *trace)
+{
+    reader->file = NULL;
+    reader->trace = trace;
+    reader->position = 0;
+    reader->hash = TRACE_HASH_EMPTY;
+    reader->malformed = false;
+    reader->buffer_pos = 0;
+    reader->buffer_len = 0;
+}
+
+uint64_t trace_hash_record(uint64_t hash, struct trace_record *record)
+{
+    for (int i = 0; i < 4; i++) {
+        hash = (hash ^ ((record->address >> (8 * i)) & 0xff)) * FNV_PRIME;
+    }
+    hash = (hash ^ (unsigned char)record->rw) * FNV_PRIME;
+
+    // Single-core traces hash the same whether or not the core is given.
+    if (record->core != 0) {
+        hash = (hash ^ (record->core & 0xff)) * FNV_PRIME;
+        hash = (hash ^ (record->core >> 8)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+bool trace_reader_next(struct trace_reader *reader, struct trace_record *record)
+{
+    PROFILE_WINDOW();
+    PROFILE_ENTER(PROFILE_PARSE);
+    bool found;
+    if (reader->trace != NULL) {
+        found = reader->position < reader->trace->length;
+        if (found) *record = reader->trace->records[reader->position];
+    } else {
+        found = trace_reader_parse(reader, record);
+    }
+
+    if (found) {
+        reader->position++;
+        reader->hash = trace_hash_record(reader->hash, record);
+    }
+    PROFILE_EXIT();
+    return found;
+}
@@ -0,0 +1,67 @@
+//
+// This file defines the structs and function signatures necessary for reading
+// memory access traces. A trace can either be streamed record-by-record from
+// a file or loaded entirely into memory (which is required by modes that need
+// to look ahead in the trace, like the OPT replacement policy).
+//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TRACE_READ_BUFFER_SIZE (1 << 16)
+
+// The hash of a trace without any records.
+#define TRACE_HASH_EMPTY 0xcbf29ce484222325ull
+
+// A single decoded memory access.
+struct trace_record {
+    uint32_t address;
+    char rw;       // 'R' or 'W'
+    uint16_t core; // The core/thread that performed the access (0 if not given)
+};
+
+// A trace that has been loaded into memory.
+struct trace {
+    struct trace_record *records;
+    size_t length;
+    size_t capacity;
+};
+
+// Reads records either from a file or from an in-memory trace.
+struct trace_reader {
+    FILE *file;          // The file to parse records from (NULL if reading a trace)
+    struct trace *trace; // The in-memory trace to read from (NULL if reading a file)
+    size_t position;     // The number of records returned so far
+    uint64_t hash;       // FNV-1a hash of the records returned so far
+    bool malformed;      // Whether reading stopped at a malformed record
+
+    // Read buffer for parsing the file.
+    char buffer[TRACE_READ_BUFFER_SIZE];
+    size_t buffer_pos, buffer_len;
+};
+
+// Load all of the records from the given file into memory. Returns NULL if the
+// file contains a malformed record (an error is printed).
+struct trace *trace_load(FILE *file);
+void trace_cleanup(struct trace *trace);
+
+// Initialize a reader over a file or over an in-memory trace.
+void trace_reader_init_file(struct trace_reader *reader, FILE *file);
+void trace_reader_init_trace(struct trace_reader *reader, struct trace *trace);
+
+// Read the next record. Returns false once the end of the trace is reached, or
+// at a malformed record, in which case an error is printed and `malformed` is
+// set.
+bool trace_reader_next(struct trace_reader *reader, struct trace_record *record);
+
+// Fold a record into the running hash of a trace, and return the new hash. The
+// hash identifies the contents of a trace independently of how it was
+// formatted.
+uint64_t trace_hash_record(uint64_t hash, struct trace_record *record);
+
+#endif
@@ -0,0 +1,350 @@
+//
+// This file contains the implementation of the `analyze` subcommand defined in
+// trace_analyze.h.
+//
+// Reuse distances are computed with a Fenwick tree over a window of
+// timestamps: every line has a mark at the timestamp of its last access, so
+// the reuse distance of an access is the number of marks after the previous
+// access to its line. When the window is used up, the timestamps are
+// renumbered by rank, which keeps the tree proportional to the number of
+// distinct lines.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "line_map.h"
+#include "options.h"
+#include "trace.h"
+#include "trace_analyze.h"
+
+#define TRACE_ANALYZE_BUCKETS 34 // Zero and one bucket per bit of a 33-bit value
+#define TRACE_ANALYZE_MIN_WINDOW (1 << 16)
+#define TRACE_ANALYZE_NEVER UINT64_MAX
+
+struct reuse_tracker {
+    struct line_map *last_access; // Line ID -> timestamp of its last access
+    uint32_t *tree;               // Fenwick tree over the timestamps (1-based)
+    uint64_t window;              // Number of timestamps in the tree
+    uint64_t now;                 // The next timestamp
+};
+
+struct trace_analysis {
+    uint32_t line_bits, page_bits;
+
+    uint64_t reads, writes;
+    struct reuse_tracker reuse;
+    struct line_map *page_lines; // Page number -> distinct lines touched
+
+    uint64_t cold_accesses;
+    uint64_t reuse_distances[TRACE_ANALYZE_BUCKETS];
+
+    bool has_previous;
+    uint32_t previous_line;
+    uint64_t strides[2][TRACE_ANALYZE_BUCKETS]; // Negative and positive strides
+};
+
+// The bucket of a value: 0 for 0, and k for [2^(k-1), 2^k - 1].
+static uint32_t bucket(uint64_t value)
+{
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+static uint64_t bucket_min(uint32_t bucket)
+{
+    return bucket == 0 ? 0 : 1ull << (bucket - 1);
+}
+
+static uint64_t bucket_max(uint32_t bucket)
+{
+    return bucket == 0 ? 0 : (1ull << bucket) - 1;
+}
+
+static void fenwick_add(uint32_t *tree, uint64_t window, uint64_t position, int32_t delta)
+{
+    for (uint64_t i = position + 1; i <= window; i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+// The number of marks at timestamps below `end`.
+static uint64_t fenwick_prefix(uint32_t *tree, uint64_t end)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = end; i > 0; i -= i & -i) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+struct timestamped_line {
+    uint64_t timestamp;
+    uint32_t line_id;
+};
+
+static int compare_timestamps(const void *a, const void *b)
+{
+    uint64_t x = ((const struct timestamped_line *)a)->timestamp;
+    uint64_t y = ((const struct timestamped_line *)b)->timestamp;
+    return (x > y) - (x < y);
+}
+
+// Renumber the last accesses 0..lines-1 (keeping their order) and rebuild the
+// tree with room for as many new timestamps as there are lines.
+static void reuse_tracker_compact(struct reuse_tracker *reuse)
+{
+    struct line_map *map = reuse->last_access;
+    struct timestamped_line *lines = malloc(map->size * sizeof(struct timestamped_line));
+    uint64_t count = 0;
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (!map->entries[i].used) continue;
+        lines[count].timestamp = map->entries[i].value;
+        lines[count].line_id = map->entries[i].key;
+        count++;
+    }
+    qsort(lines, count, sizeof(struct timestamped_line), compare_timestamps);
+    for (uint64_t i = 0; i < count; i++) {
+        line_map_put(map, lines[i].line_id, i);
+    }
+    free(lines);
+
+    reuse->window = count * 2 > TRACE_ANALYZE_MIN_WINDOW ? count * 2 : TRACE_ANALYZE_MIN_WINDOW;
+    free(reuse->tree);
+    reuse->tree = calloc(reuse->window + 1, sizeof(uint32_t));
+    // Build the tree with a mark at every one of the first `count` timestamps
+    // in linear time. The partial sums are pushed up through the whole tree.
+    for (uint64_t i = 1; i <= reuse->window; i++) {
+        if (i <= count) reuse->tree[i]++;
+        uint64_t parent = i + (i & -i);
+        if (parent <= reuse->window) reuse->tree[parent] += reuse->tree[i];
+    }
+    reuse->now = count;
+}
+
+// Record an access to the line. Returns its reuse distance, or
+// TRACE_ANALYZE_NEVER if this is the first access to it.
+static uint64_t reuse_tracker_access(struct reuse_tracker *reuse, uint32_t line_id)
+{
+    if (reuse->now == reuse->window) {
+        reuse_tracker_compact(reuse);
+    }
+
+    uint64_t *last = line_map_upsert(reuse->last_access, line_id, TRACE_ANALYZE_NEVER);
+    uint64_t distance = TRACE_ANALYZE_NEVER;
+    if (*last != TRACE_ANALYZE_NEVER) {
+        distance = fenwick_prefix(reuse->tree, reuse->now) -
+                   fenwick_prefix(reuse->tree, *last + 1);
+        fenwick_add(reuse->tree, reuse->window, *last, -1);
+    }
+    *last = reuse->now;
+    fenwick_add(reuse->tree, reuse->window, reuse->now, 1);
+    reuse->now++;
+    return distance;
+}
+
+static void trace_analysis_record(struct trace_analysis *analysis, struct trace_record *record)
+{
+    if (record->rw == 'W') {
+        analysis->writes++;
+    } else {
+        analysis->reads++;
+    }
+
+    uint32_t line_id = record->address >> analysis->line_bits;
+    uint64_t distance = reuse_tracker_access(&analysis->reuse, line_id);
+    if (distance == TRACE_ANALYZE_NEVER) {
+        analysis->cold_accesses++;
+        (*line_map_upsert(analysis->page_lines, record->address >> analysis->page_bits, 0))++;
+    } else {
+        analysis->reuse_distances[bucket(distance)]++;
+    }
+
+    if (analysis->has_previous) {
+        int64_t stride = (int64_t)line_id - analysis->previous_line;
+        analysis->strides[stride > 0][bucket(stride < 0 ? -stride : stride)]++;
+    }
+    analysis->has_previous = true;
+    analysis->previous_line = line_id;
+}
+
+// The histogram of the number of distinct lines touched per page.
+static void trace_analysis_page_density(struct trace_analysis *analysis, uint64_t *histogram)
+{
+    struct line_map *pages = analysis->page_lines;
+    for (size_t i = 0; i < pages->capacity; i++) {
+        if (pages->entries[i].used) histogram[bucket(pages->entries[i].value)]++;
+    }
+}
+
+static void print_text(FILE *out, struct trace_analysis *analysis)
+{
+    uint64_t records = analysis->reads + analysis->writes;
+    uint64_t distinct_lines = analysis->reuse.last_access->size;
+    uint64_t distinct_pages = analysis->page_lines->size;
+    uint32_t lines_per_page = 1u << (analysis->page_bits - analysis->line_bits);
+
+    fprintf(out, "Trace Analysis\n");
+    fprintf(out, "==============\n");
+    fprintf(out, "OUTPUT RECORDS %lu\n", (unsigned long)records);
+    fprintf(out, "OUTPUT READS %lu\n", (unsigned long)analysis->reads);
+    fprintf(out, "OUTPUT WRITES %lu\n", (unsigned long)analysis->writes);
+    fprintf(out, "OUTPUT WRITE RATIO %.8f\n",
+            records ? (double)analysis->writes / records : 0.0);
+    fprintf(out, "OUTPUT DISTINCT LINES %lu\n", (unsigned long)distinct_lines);
+    fprintf(out, "OUTPUT DISTINCT PAGES %lu\n", (unsigned long)distinct_pages);
+    fprintf(out, "OUTPUT AVERAGE PAGE DENSITY %.8f\n",
+            distinct_pages ? (double)distinct_lines / distinct_pages / lines_per_page : 0.0);
+
+    // A cache of max + 1 lines hits every access up to and including the row.
+    fprintf(out, "\n\nReuse Distances (lines)\n");
+    fprintf(out, "=======================\n");
+    fprintf(out, "min,max,accesses,lru_hit_ratio\n");
+    uint64_t cumulative = 0;
+    for (uint32_t i = 0; i < TRACE_ANALYZE_BUCKETS; i++) {
+        if (analysis->reuse_distances[i] == 0) continue;
+        cumulative += analysis->reuse_distances[i];
+        fprintf(out, "%lu,%lu,%lu,%.8f\n", (unsigned long)bucket_min(i),
+                (unsigned long)bucket_max(i), (unsigned long)analysis->reuse_distances[i],
+                (double)cumulative / records);
+    }
+    fprintf(out, "cold,cold,%lu,%.8f\n", (unsigned long)analysis->cold_accesses, 1.0);
+
+    fprintf(out, "\n\nStrides (lines)\n");
+    fprintf(out, "===============\n");
+    fprintf(out, "min,max,accesses\n");
+    for (uint32_t i = TRACE_ANALYZE_BUCKETS - 1; i > 0; i--) {
+        if (analysis->strides[0][i] == 0) continue;
+        fprintf(out, "-%lu,-%lu,%lu\n", (unsigned long)bucket_max(i),
+                (unsigned long)bucket_min(i), (unsigned long)analysis->strides[0][i]);
+    }
+    for (uint32_t i = 0; i < TRACE_ANALYZE_BUCKETS; i++) {
+        uint64_t count = i == 0 ? analysis->strides[0][0] : analysis->strides[1][i];
+        if (count == 0) continue;
+        fprintf(out, "%lu,%lu,%lu\n", (unsigned long)bucket_min(i),
+                (unsigned long)bucket_max(i), (unsigned long)count);
+    }
+
+    uint64_t density[TRACE_ANALYZE_BUCKETS] = {0};
+    trace_analysis_page_density(analysis, density);
+    fprintf(out, "\n\nLines Touched per Page (of %u)\n", lines_per_page);
+    fprintf(out, "==============================\n");
+    fprintf(out, "min,max,pages\n");
+    for (uint32_t i = 1; i < TRACE_ANALYZE_BUCKETS; i++) {
+        if (density[i] == 0) continue;
+        fprintf(out, "%lu,%lu,%lu\n", (unsigned long)bucket_min(i),
+                (unsigned long)bucket_max(i), (unsigned long)density[i]);
+    }
+}
+
+static void print_json_histogram(FILE *out, const char *name, uint64_t *histogram, bool negative)
+{
+    fprintf(out, ", \"%s\": [", name);
+    bool first = true;
+    for (uint32_t i = 0; i < TRACE_ANALYZE_BUCKETS; i++) {
+        uint32_t b = negative ? TRACE_ANALYZE_BUCKETS - 1 - i : i;
+        if (histogram[b] == 0) continue;
+        fprintf(out, "%s{\"min\": %s%lu, \"max\": %s%lu, \"count\": %lu}", first ? "" : ", ",
+                negative ? "-" : "", (unsigned long)(negative ? bucket_max(b) : bucket_min(b)),
+                negative ? "-" : "", (unsigned long)(negative ? bucket_min(b) : bucket_max(b)),
+                (unsigned long)histogram[b]);
+        first = false;
+    }
+    fprintf(out, "]");
+}
+
+static void print_json(FILE *out, struct trace_analysis *analysis)
+{
+    fprintf(out,
+            "{\"line_size\": %u, \"page_size\": %u, \"reads\": %lu, \"writes\": %lu, "
+            "\"distinct_lines\": %lu, \"distinct_pages\": %lu, \"cold_accesses\": %lu",
+            1u << analysis->line_bits, 1u << analysis->page_bits,
+            (unsigned long)analysis->reads, (unsigned long)analysis->writes,
+            (unsigned long)analysis->reuse.last_access->size,
+            (unsigned long)analysis->page_lines->size, (unsigned long)analysis->cold_accesses);
+    print_json_histogram(out, "reuse_distances", analysis->reuse_distances, false);
+
+    // Zero strides are only counted in the first histogram.
+    uint64_t positive[TRACE_ANALYZE_BUCKETS];
+    memcpy(positive, analysis->strides[1], sizeof(positive));
+    positive[0] = analysis->strides[0][0];
+    uint64_t negative[TRACE_ANALYZE_BUCKETS];
+    memcpy(negative, analysis->strides[0], sizeof(negative));
+    negative[0] = 0;
+    print_json_histogram(out, "negative_strides", negative, true);
+    print_json_histogram(out, "strides", positive, false);
+
+    uint64_t density[TRACE_ANALYZE_BUCKETS] = {0};
+    trace_analysis_page_density(analysis, density);
+    print_json_histogram(out, "lines_per_page", density, false);
+    fprintf(out, "}\n");
+}
+
+static bool is_power_of_two(uint32_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+int trace_analyze_main(int argc, char **argv)
+{
+    uint32_t line_size = 64;
+    uint32_t page_size = 4096;
+    bool json = false;
+    for (int i = 1; i < argc; i++) {
+        const char *value;
+        if ((value = option_value(argv[i], "line-size"))) {
+            line_size = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "page-size"))) {
+            page_size = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "format"))) {
+            if (!strcmp(value, "json")) {
+                json = true;
+            } else if (strcmp(value, "text")) {
+                fprintf(stderr, "Unknown output format %s\n", value);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: cachesim analyze [--line-size=BYTES] [--page-size=BYTES] "
+                            "[--format=text|json] < <trace_file>\n");
+            return 1;
+        }
+    }
+    if (!is_power_of_two(line_size) || !is_power_of_two(page_size) || page_size < line_size) {
+        fprintf(stderr, "The line and page sizes must be powers of two, and a page must hold at "
+                        "least one line\n");
+        return 1;
+    }
+
+    struct trace_analysis analysis = {0};
+    analysis.line_bits = __builtin_ctz(line_size);
+    analysis.page_bits = __builtin_ctz(page_size);
+    analysis.reuse.last_access = line_map_new(4096);
+    analysis.reuse.window = TRACE_ANALYZE_MIN_WINDOW;
+    analysis.reuse.tree = calloc(analysis.reuse.window + 1, sizeof(uint32_t));
+    analysis.page_lines = line_map_new(1024);
+
+    struct trace_reader *reader = malloc(sizeof(struct trace_reader));
+    trace_reader_init_file(reader, stdin);
+    struct trace_record record;
+    while (trace_reader_next(reader, &record)) {
+        trace_analysis_record(&analysis, &record);
+    }
+    bool malformed = reader->malformed;
+    free(reader);
+    if (malformed) return 1;
+
+    if (json) {
+        print_json(stdout, &analysis);
+    } else {
+        print_text(stdout, &analysis);
+    }
+
+    line_map_cleanup(analysis.reuse.last_access);
+    free(analysis.reuse.last_access);
+    free(analysis.reuse.tree);
+    line_map_cleanup(analysis.page_lines);
+    free(analysis.page_lines);
+    return 0;
+}
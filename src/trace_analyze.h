@@ -0,0 +1,27 @@
+//
+// This file defines the entrypoint of the `analyze` subcommand, which streams
+// a trace (from stdin) once and characterizes it without simulating a cache:
+//
+//      cachesim analyze [--line-size=BYTES] [--page-size=BYTES] [--format=text|json]
+//
+// It reports:
+//  * The read/write mix and the number of distinct lines and pages.
+//  * A histogram of the reuse distances of the lines (the number of distinct
+//    other lines accessed since the previous access to the same line). An
+//    access with a reuse distance below N hits in a fully associative LRU
+//    cache of N lines, so the cumulative column is the hit ratio of such a
+//    cache as a function of its size.
+//  * A histogram of the strides (in lines) between consecutive accesses.
+//  * A histogram of the number of distinct lines touched within each page.
+//
+// The histograms use power-of-two buckets. The memory used is proportional to
+// the number of distinct lines rather than the length of the trace.
+//
+
+#ifndef TRACE_ANALYZE_H
+#define TRACE_ANALYZE_H
+
+// Run the subcommand. argv[0] is "analyze". Returns the exit status.
+int trace_analyze_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,218 @@
+//
+// This file contains the implementation of the `gen-trace` subcommand defined
+// in trace_gen.h.
+//
+// Every pattern is driven by a seeded xorshift64* generator, so the same
+// arguments always produce the same trace.
+//
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "options.h"
+#include "trace_gen.h"
+
+#define TRACE_GEN_BASE_ADDRESS 0x10000000
+#define TRACE_GEN_WORD_SIZE 4
+#define TRACE_GEN_NODE_SIZE 64 // Size of a zipf line or pointer-chase node
+
+enum trace_pattern {
+    PATTERN_SEQUENTIAL,
+    PATTERN_STRIDE,
+    PATTERN_RANDOM,
+    PATTERN_ZIPF,
+    PATTERN_POINTER_CHASE,
+    PATTERN_MIXED,
+};
+
+struct trace_gen {
+    uint64_t rng;
+    uint32_t footprint;
+    uint32_t stride;
+    uint32_t nodes; // Number of 64B lines/nodes within the footprint
+
+    // Cursors of the sequential and stride streams.
+    uint32_t sequential_offset;
+    uint32_t stride_offset;
+
+    // Cumulative distribution of the zipf ranks.
+    double *zipf_cdf;
+
+    // The next node of each pointer-chase node, and the current node.
+    uint32_t *next_node;
+    uint32_t current_node;
+};
+
+static uint64_t trace_gen_rand(struct trace_gen *gen)
+{
+    // xorshift64*
+    gen->rng ^= gen->rng >> 12;
+    gen->rng ^= gen->rng << 25;
+    gen->rng ^= gen->rng >> 27;
+    return gen->rng * 0x2545F4914F6CDD1Dull;
+}
+
+// A uniformly random integer in [0, bound).
+static uint32_t trace_gen_below(struct trace_gen *gen, uint32_t bound)
+{
+    return (uint32_t)((trace_gen_rand(gen) >> 32) * bound >> 32);
+}
+
+static bool parse_pattern(const char *name, enum trace_pattern *pattern)
+{
+    const char *names[] = {"sequential", "stride", "random", "zipf", "pointer-chase", "mixed"};
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (!strcmp(name, names[i])) {
+            *pattern = (enum trace_pattern)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void trace_gen_init_zipf(struct trace_gen *gen, double exponent)
+{
+    gen->zipf_cdf = malloc(gen->nodes * sizeof(double));
+    double total = 0;
+    for (uint32_t i = 0; i < gen->nodes; i++) {
+        total += 1.0 / pow(i + 1, exponent);
+        gen->zipf_cdf[i] = total;
+    }
+    for (uint32_t i = 0; i < gen->nodes; i++) {
+        gen->zipf_cdf[i] /= total;
+    }
+}
+
+static void trace_gen_init_pointer_chase(struct trace_gen *gen)
+{
+    // Sattolo's algorithm produces a random permutation with a single cycle,
+    // so the chase visits every node before repeating.
+    gen->next_node = malloc(gen->nodes * sizeof(uint32_t));
+    for (uint32_t i = 0; i < gen->nodes; i++) {
+        gen->next_node[i] = i;
+    }
+    for (uint32_t i = gen->nodes - 1; i > 0; i--) {
+        uint32_t j = trace_gen_below(gen, i);
+        uint32_t tmp = gen->next_node[i];
+        gen->next_node[i] = gen->next_node[j];
+        gen->next_node[j] = tmp;
+    }
+    gen->current_node = 0;
+}
+
+static uint32_t trace_gen_zipf_node(struct trace_gen *gen)
+{
+    // Find the rank by binary search over the CDF.
+    double u = (trace_gen_rand(gen) >> 11) * (1.0 / 9007199254740992.0);
+    uint32_t lo = 0, hi = gen->nodes - 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (gen->zipf_cdf[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    // Scatter the ranks over the footprint so that the hot lines are not
+    // adjacent. Multiplying by an odd constant is a bijection modulo a power of
+    // two, and close to one otherwise.
+    return (uint32_t)(((uint64_t)lo * 2654435761u) % gen->nodes);
+}
+
+// The offset (within the footprint) of the next access of the given pattern.
+static uint32_t trace_gen_next_offset(struct trace_gen *gen, enum trace_pattern pattern)
+{
+    uint32_t offset;
+    switch (pattern) {
+    case PATTERN_SEQUENTIAL:
+        offset = gen->sequential_offset;
+        gen->sequential_offset = (gen->sequential_offset + TRACE_GEN_WORD_SIZE) % gen->footprint;
+        return offset;
+    case PATTERN_STRIDE:
+        offset = gen->stride_offset;
+        gen->stride_offset = (gen->stride_offset + gen->stride) % gen->footprint;
+        return offset;
+    case PATTERN_RANDOM:
+        return trace_gen_below(gen, gen->footprint / TRACE_GEN_WORD_SIZE) * TRACE_GEN_WORD_SIZE;
+    case PATTERN_ZIPF:
+        return trace_gen_zipf_node(gen) * TRACE_GEN_NODE_SIZE +
+               trace_gen_below(gen, TRACE_GEN_NODE_SIZE / TRACE_GEN_WORD_SIZE) *
+                   TRACE_GEN_WORD_SIZE;
+    case PATTERN_POINTER_CHASE:
+        gen->current_node = gen->next_node[gen->current_node];
+        return gen->current_node * TRACE_GEN_NODE_SIZE;
+    case PATTERN_MIXED:
+        return trace_gen_next_offset(gen, (enum trace_pattern)trace_gen_below(gen, PATTERN_MIXED));
+    }
+    return 0;
+}
+
+int trace_gen_main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: cachesim gen-trace <pattern> <records> [--seed=N] "
+                        "[--footprint=BYTES] [--stride=BYTES] [--writes=PERCENT] [--zipf=S]\n");
+        return 1;
+    }
+
+    enum trace_pattern pattern;
+    if (!parse_pattern(argv[1], &pattern)) {
+        fprintf(stderr, "Unknown trace pattern %s\n", argv[1]);
+        return 1;
+    }
+    uint64_t records = strtoull(argv[2], NULL, 10);
+
+    uint64_t seed = 1;
+    uint32_t footprint = 16 << 20;
+    uint32_t stride = 256;
+    uint32_t writes = pattern == PATTERN_MIXED ? 30 : 0;
+    double zipf_exponent = 1.0;
+    for (int i = 3; i < argc; i++) {
+        const char *value;
+        if ((value = option_value(argv[i], "seed"))) {
+            seed = strtoull(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "footprint"))) {
+            footprint = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "stride"))) {
+            stride = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "writes"))) {
+            writes = strtoul(value, NULL, 10);
+        } else if ((value = option_value(argv[i], "zipf"))) {
+            zipf_exponent = strtod(value, NULL);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (footprint < TRACE_GEN_NODE_SIZE || stride == 0) {
+        fprintf(stderr, "The footprint must be at least %d bytes and the stride non-zero\n",
+                TRACE_GEN_NODE_SIZE);
+        return 1;
+    }
+
+    struct trace_gen gen = {0};
+    gen.rng = seed * 0x9E3779B97F4A7C15ull + 1; // xorshift must not start at zero
+    gen.footprint = footprint;
+    gen.stride = stride;
+    gen.nodes = footprint / TRACE_GEN_NODE_SIZE;
+    if (pattern == PATTERN_ZIPF || pattern == PATTERN_MIXED) {
+        trace_gen_init_zipf(&gen, zipf_exponent);
+    }
+    if (pattern == PATTERN_POINTER_CHASE || pattern == PATTERN_MIXED) {
+        trace_gen_init_pointer_chase(&gen);
+    }
+
+    for (uint64_t i = 0; i < records; i++) {
+        uint32_t address = TRACE_GEN_BASE_ADDRESS + trace_gen_next_offset(&gen, pattern);
+        char rw = trace_gen_below(&gen, 100) < writes ? 'W' : 'R';
+        printf("%c 0x%x\n", rw, address);
+    }
+
+    free(gen.zipf_cdf);
+    free(gen.next_node);
+    return 0;
+}
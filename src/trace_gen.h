@@ -0,0 +1,26 @@
+//
+// This file defines the entrypoint of the `gen-trace` subcommand, which writes
+// large, reproducible synthetic traces (in the same text format as the traces
+// in inputs/) for benchmarking the simulator.
+//
+// Usage:
+//
+//      cachesim gen-trace <pattern> <records> [--seed=N] [--footprint=BYTES]
+//                         [--stride=BYTES] [--writes=PERCENT] [--zipf=S]
+//
+// Patterns:
+//  * sequential: consecutive words, wrapping around the footprint
+//  * stride: a fixed stride (--stride, default 256B), wrapping around the footprint
+//  * random: uniformly random words within the footprint
+//  * zipf: 64B lines of the footprint with Zipfian popularity (--zipf, default 1.0)
+//  * pointer-chase: a random cyclic linked list of 64B nodes spanning the footprint
+//  * mixed: a random interleaving of the patterns above with 30% writes
+//
+
+#ifndef TRACE_GEN_H
+#define TRACE_GEN_H
+
+// Run the subcommand. argv[0] is "gen-trace". Returns the exit status.
+int trace_gen_main(int argc, char **argv);
+
+#endif
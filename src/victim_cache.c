@@ -0,0 +1,94 @@
+//
+// This file contains the implementations for the functions defined in
+// victim_cache.h.
+//
+
+#include <stdlib.h>
+
+#include "line_map.h"
+#include "victim_cache.h"
+
+struct victim_cache *victim_cache_new(uint32_t capacity)
+{
+    struct victim_cache *victim_cache = calloc(1, sizeof(struct victim_cache));
+    victim_cache->capacity = capacity;
+    victim_cache->entries = calloc(capacity, sizeof(struct victim_cache_entry));
+    victim_cache->mru = victim_cache->lru = VICTIM_CACHE_NONE;
+    for (uint32_t i = 0; i < capacity; i++) {
+        victim_cache->entries[i].next = i + 1 < capacity ? i + 1 : VICTIM_CACHE_NONE;
+    }
+    victim_cache->free_list = 0;
+    victim_cache->index = line_map_new(capacity);
+    return victim_cache;
+}
+
+void victim_cache_cleanup(struct victim_cache *victim_cache)
+{
+    free(victim_cache->entries);
+    line_map_cleanup(victim_cache->index);
+    free(victim_cache->index);
+}
+
+// Unlink the entry from the LRU list and put it on the free list.
+static void victim_cache_remove(struct victim_cache *victim_cache, uint32_t slot)
+{
+    struct victim_cache_entry *entry = &victim_cache->entries[slot];
+    if (entry->prev != VICTIM_CACHE_NONE) {
+        victim_cache->entries[entry->prev].next = entry->next;
+    } else {
+        victim_cache->mru = entry->next;
+    }
+    if (entry->next != VICTIM_CACHE_NONE) {
+        victim_cache->entries[entry->next].prev = entry->prev;
+    } else {
+        victim_cache->lru = entry->prev;
+    }
+
+    line_map_remove(victim_cache->index, entry->line_id);
+    entry->next = victim_cache->free_list;
+    victim_cache->free_list = slot;
+    victim_cache->size--;
+}
+
+bool victim_cache_contains(struct victim_cache *victim_cache, uint32_t line_id)
+{
+    return line_map_get(victim_cache->index, line_id) != NULL;
+}
+
+bool victim_cache_take(struct victim_cache *victim_cache, uint32_t line_id,
+                       enum cache_status *status)
+{
+    uint64_t *slot = line_map_get(victim_cache->index, line_id);
+    if (slot == NULL) return false;
+    *status = victim_cache->entries[*slot].status;
+    victim_cache_remove(victim_cache, *slot);
+    return true;
+}
+
+bool victim_cache_insert(struct victim_cache *victim_cache, uint32_t line_id,
+                         enum cache_status status, struct victim_cache_entry *displaced)
+{
+    bool full = victim_cache->size == victim_cache->capacity;
+    if (full) {
+        *displaced = victim_cache->entries[victim_cache->lru];
+        victim_cache_remove(victim_cache, victim_cache->lru);
+    }
+
+    // Take a free entry and make it the MRU one.
+    uint32_t slot = victim_cache->free_list;
+    struct victim_cache_entry *entry = &victim_cache->entries[slot];
+    victim_cache->free_list = entry->next;
+    entry->line_id = line_id;
+    entry->status = status;
+    entry->prev = VICTIM_CACHE_NONE;
+    entry->next = victim_cache->mru;
+    if (victim_cache->mru != VICTIM_CACHE_NONE) {
+        victim_cache->entries[victim_cache->mru].prev = slot;
+    } else {
+        victim_cache->lru = slot;
+    }
+    victim_cache->mru = slot;
+    line_map_put(victim_cache->index, line_id, slot);
+    victim_cache->size++;
+    return full;
+}
@@ -0,0 +1,55 @@
+//
+// This file defines the struct and function signatures for a victim cache: a
+// small, fully-associative cache that holds the lines most recently evicted
+// from the main cache array. A miss in the main array that hits in the victim
+// cache swaps the line back without going to the next level, which absorbs
+// conflict misses between a few lines that map to the same set.
+//
+// The victim cache is LRU. Lookups go through a line_map from the line ID to
+// the entry, and the LRU order is a doubly-linked list through the entries, so
+// every operation is O(1).
+//
+
+#ifndef VICTIM_CACHE_H
+#define VICTIM_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "memory_system.h"
+
+#define VICTIM_CACHE_MAX_ENTRIES 4096
+#define VICTIM_CACHE_NONE UINT32_MAX
+
+struct victim_cache_entry {
+    uint32_t line_id;
+    enum cache_status status;
+    uint32_t prev, next; // Towards the MRU and LRU ends (or the next free entry)
+};
+
+struct victim_cache {
+    uint32_t capacity;
+    uint32_t size;
+    struct victim_cache_entry *entries;
+    uint32_t mru, lru;  // Ends of the LRU list
+    uint32_t free_list; // Unused entries, linked through `next`
+    struct line_map *index; // Line ID -> entry
+};
+
+struct victim_cache *victim_cache_new(uint32_t capacity);
+void victim_cache_cleanup(struct victim_cache *victim_cache);
+
+// Returns whether the line is in the victim cache.
+bool victim_cache_contains(struct victim_cache *victim_cache, uint32_t line_id);
+
+// If the line is in the victim cache, remove it, store its status in `status`,
+// and return true.
+bool victim_cache_take(struct victim_cache *victim_cache, uint32_t line_id,
+                       enum cache_status *status);
+
+// Insert a line evicted from the main array. If the victim cache is full, the
+// LRU line is displaced: it is stored in `displaced` and true is returned.
+bool victim_cache_insert(struct victim_cache *victim_cache, uint32_t line_id,
+                         enum cache_status status, struct victim_cache_entry *displaced);
+
+#endif
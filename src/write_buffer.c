@@ -0,0 +1,84 @@
+//
+// This file contains the implementations for the functions defined in
+// write_buffer.h.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory_system.h"
+#include "write_buffer.h"
+
+struct write_buffer *write_buffer_new(uint32_t capacity, uint32_t line_size, uint32_t word_size)
+{
+    struct write_buffer *write_buffer = calloc(1, sizeof(struct write_buffer));
+    write_buffer->capacity = capacity;
+    write_buffer->word_size = word_size < line_size ? word_size : line_size;
+    write_buffer->words_per_line = line_size / write_buffer->word_size;
+    write_buffer->entries = calloc(capacity, sizeof(struct write_buffer_entry));
+    uint32_t bitmap_words = (write_buffer->words_per_line + 63) / 64;
+    for (uint32_t i = 0; i < capacity; i++) {
+        write_buffer->entries[i].written = calloc(bitmap_words, sizeof(uint64_t));
+    }
+    return write_buffer;
+}
+
+void write_buffer_cleanup(struct write_buffer *write_buffer)
+{
+    for (uint32_t i = 0; i < write_buffer->capacity; i++) {
+        free(write_buffer->entries[i].written);
+    }
+    free(write_buffer->entries);
+}
+
+// Drain the oldest entry to the next level.
+static void write_buffer_drain_oldest(struct write_buffer *write_buffer,
+                                      struct cache_system_stats *stats)
+{
+    struct write_buffer_entry *entry = &write_buffer->entries[write_buffer->oldest];
+    stats->bytes_written += entry->words * write_buffer->word_size;
+    memset(entry->written, 0, (write_buffer->words_per_line + 63) / 64 * sizeof(uint64_t));
+    entry->words = 0;
+    write_buffer->oldest = (write_buffer->oldest + 1) % write_buffer->capacity;
+    write_buffer->size--;
+}
+
+void write_buffer_write(struct write_buffer *write_buffer, uint32_t line_id, uint32_t word,
+                        struct cache_system_stats *stats)
+{
+    // Look for an entry holding the line. The buffer is small, as in hardware,
+    // so a linear search is fine.
+    struct write_buffer_entry *entry = NULL;
+    for (uint32_t i = 0; i < write_buffer->size; i++) {
+        struct write_buffer_entry *candidate =
+            &write_buffer->entries[(write_buffer->oldest + i) % write_buffer->capacity];
+        if (candidate->line_id == line_id) {
+            entry = candidate;
+            stats->write_buffer_coalesced++;
+            break;
+        }
+    }
+
+    if (entry == NULL) {
+        if (write_buffer->size == write_buffer->capacity) {
+            write_buffer_drain_oldest(write_buffer, stats);
+        }
+        entry = &write_buffer->entries[(write_buffer->oldest + write_buffer->size) %
+                                       write_buffer->capacity];
+        entry->line_id = line_id;
+        write_buffer->size++;
+    }
+
+    uint64_t bit = 1ull << (word % 64);
+    if (!(entry->written[word / 64] & bit)) {
+        entry->written[word / 64] |= bit;
+        entry->words++;
+    }
+}
+
+void write_buffer_drain(struct write_buffer *write_buffer, struct cache_system_stats *stats)
+{
+    while (write_buffer->size > 0) {
+        write_buffer_drain_oldest(write_buffer, stats);
+    }
+}
@@ -0,0 +1,53 @@
+//
+// This file defines the struct and function signatures for a coalescing write
+// buffer between a cache and the next level of the memory hierarchy.
+//
+// Writes that go to the next level one word at a time (write-through stores
+// and writes that miss under no-write-allocate) are collected in the buffer.
+// Each entry covers one line and remembers which of its words were written, so
+// repeated writes to the same line are merged into a single transfer. When the
+// buffer is full, the oldest entry is drained and its written words are
+// counted as bytes written. Dirty evictions transfer whole lines and bypass the
+// buffer.
+//
+
+#ifndef WRITE_BUFFER_H
+#define WRITE_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct cache_system_stats;
+
+#define WRITE_BUFFER_MAX_ENTRIES 1024
+
+struct write_buffer_entry {
+    uint32_t line_id;
+    uint32_t words;     // Number of distinct words written
+    uint64_t *written; // Bitmap of the words of the line that were written
+};
+
+struct write_buffer {
+    uint32_t capacity;
+    uint32_t words_per_line;
+    uint32_t word_size;
+
+    // The entries form a FIFO ring; `oldest` is the next entry to drain.
+    struct write_buffer_entry *entries;
+    uint32_t oldest;
+    uint32_t size;
+};
+
+struct write_buffer *write_buffer_new(uint32_t capacity, uint32_t line_size, uint32_t word_size);
+void write_buffer_cleanup(struct write_buffer *write_buffer);
+
+// Buffer a write of the given word of the given line. A write to a line that
+// is already buffered is coalesced (and counted in `write_buffer_coalesced`);
+// otherwise the oldest entry may be drained (counted in `bytes_written`).
+void write_buffer_write(struct write_buffer *write_buffer, uint32_t line_id, uint32_t word,
+                        struct cache_system_stats *stats);
+
+// Drain every buffered entry (at the end of the simulation).
+void write_buffer_drain(struct write_buffer *write_buffer, struct cache_system_stats *stats);
+
+#endif